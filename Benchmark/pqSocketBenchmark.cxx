@@ -0,0 +1,447 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketBenchmark.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+// Measures the network path of the remote control plugin: a pqSocketEndpoint
+// serving a stub handler that echoes every request, driven by client threads
+// over loopback TCP or a local socket.  With --external the clients talk to
+// a running ParaView instead, whose remote control must be listening with the
+// request protocol, so that the python handler is measured as well.
+
+#include "pqSocketEndpoint.h"
+#include "pqSocketHandler.h"
+#include "pqSocketIOThread.h"
+#include "pqSocketMessage.h"
+#include "pqSocketScheduler.h"
+#include "pqSocketStatistics.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTcpSocket>
+#include <QThread>
+
+#include <stdio.h>
+#include <unistd.h>
+
+namespace
+{
+  // Answers every request with its own payload.
+  class pqEchoSocketHandler : public pqSocketHandler
+  {
+  public:
+
+    pqEchoSocketHandler(QObject* parent) : pqSocketHandler(parent) {}
+
+    virtual pqSocketHandler* newInstance(QObject* parent)
+      {
+      return new pqEchoSocketHandler(parent);
+      }
+
+  protected:
+
+    virtual void executeMessage(const pqSocketMessageHeader& header,
+                                const char* payload, int payloadSize)
+      {
+      this->writeMessage(
+        pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+        payload, payloadSize);
+      }
+  };
+
+  struct pqSettings
+    {
+    QString Host;
+    int Port;
+    QString LocalName;
+    bool Local;
+    bool IOThread;
+    bool External;
+    QList<int> Sizes;
+    QList<int> Clients;
+    int Messages;
+    int RoundTrips;
+    int Window;
+    };
+
+  // Resident set size of this process in kilobytes.
+  qint64 residentMemory()
+    {
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+      {
+      return 0;
+      }
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) / 1024 : 0;
+    }
+
+  // One client connection, run with blocking I/O in its own thread so that
+  // the main thread's event loop is left to the plugin code.
+  class pqBenchmarkClient : public QThread
+  {
+  public:
+
+    pqBenchmarkClient(const pqSettings& settings, int payloadSize)
+      : Settings(settings), PayloadSize(payloadSize), ConnectTime(0),
+        ThroughputTime(0), Replies(0) {}
+
+    const pqSettings& Settings;
+    int PayloadSize;
+
+    qint64 ConnectTime;
+    pqSocketHistogram RoundTrip;
+    qint64 ThroughputTime;
+    int Replies;
+    QString Error;
+
+  protected:
+
+    virtual void run()
+      {
+      // A python script for the real handler, padded with a comment, or
+      // arbitrary bytes for the echo handler.
+      QByteArray payload = this->Settings.External ? QByteArray("None #") : QByteArray();
+      payload.append(QByteArray(qMax(0, this->PayloadSize - payload.size()), 'x'));
+
+      QElapsedTimer timer;
+      timer.start();
+      QIODevice* device;
+      QTcpSocket tcpSocket;
+      QLocalSocket localSocket;
+      if (this->Settings.Local)
+        {
+        localSocket.connectToServer(this->Settings.LocalName);
+        device = &localSocket;
+        if (!localSocket.waitForConnected(10000))
+          {
+          this->Error = localSocket.errorString();
+          return;
+          }
+        }
+      else
+        {
+        tcpSocket.connectToHost(this->Settings.Host, this->Settings.Port);
+        tcpSocket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        device = &tcpSocket;
+        if (!tcpSocket.waitForConnected(10000))
+          {
+          this->Error = tcpSocket.errorString();
+          return;
+          }
+        }
+      this->ConnectTime = timer.nsecsElapsed() / 1000;
+
+      // Latency: one request in flight at a time.
+      quint32 requestId = 0;
+      for (int i = 0; i < this->Settings.RoundTrips; ++i)
+        {
+        timer.restart();
+        this->sendRequest(device, ++requestId, payload);
+        if (!this->receiveReply(device))
+          {
+          return;
+          }
+        this->RoundTrip.add(timer.nsecsElapsed() / 1000);
+        }
+
+      // Throughput: keep a window of requests in flight.
+      timer.restart();
+      int sent = 0;
+      this->Replies = 0;
+      while (this->Replies < this->Settings.Messages)
+        {
+        while (sent < this->Settings.Messages && sent - this->Replies < this->Settings.Window)
+          {
+          this->sendRequest(device, ++requestId, payload);
+          ++sent;
+          }
+        if (!this->receiveReply(device))
+          {
+          return;
+          }
+        ++this->Replies;
+        }
+      this->ThroughputTime = timer.nsecsElapsed() / 1000;
+      }
+
+    void sendRequest(QIODevice* device, quint32 requestId, const QByteArray& payload)
+      {
+      pqSocketMessageHeader header(requestId, pqSocketMessageHeader::ScriptMessage);
+      header.PayloadSize = payload.size();
+      char headerBytes[pqSocketMessageHeader::Size];
+      header.encode(headerBytes);
+      device->write(headerBytes, pqSocketMessageHeader::Size);
+      device->write(payload);
+      }
+
+    bool readExactly(QIODevice* device, char* data, qint64 size)
+      {
+      while (size > 0)
+        {
+        // Waiting for a reply also sends the buffered requests.
+        if (!device->bytesAvailable())
+          {
+          if (!device->waitForReadyRead(30000))
+            {
+            this->Error = QString("No reply: %1").arg(device->errorString());
+            return false;
+            }
+          }
+        qint64 bytesRead = device->read(data, size);
+        if (bytesRead < 0)
+          {
+          this->Error = device->errorString();
+          return false;
+          }
+        data += bytesRead;
+        size -= bytesRead;
+        }
+      return true;
+      }
+
+    bool receiveReply(QIODevice* device)
+      {
+      char headerBytes[pqSocketMessageHeader::Size];
+      if (!this->readExactly(device, headerBytes, pqSocketMessageHeader::Size))
+        {
+        return false;
+        }
+      pqSocketMessageHeader header;
+      header.decode(headerBytes);
+      this->Reply.resize(header.PayloadSize);
+      return this->readExactly(device, this->Reply.data(), header.PayloadSize);
+      }
+
+    QByteArray Reply;
+  };
+
+  QList<int> parseList(const QString& text)
+    {
+    QList<int> values;
+    foreach (QString value, text.split(',', QString::SkipEmptyParts))
+      {
+      values.append(value.toInt());
+      }
+    return values;
+    }
+
+  void printUsage()
+    {
+    printf("usage: pqSocketBenchmark [options]\n"
+           "  --local               use a local socket instead of TCP\n"
+           "  --io-thread           do the plugin's network I/O in a separate thread\n"
+           "  --port <port>         TCP port, 19000 by default\n"
+           "  --name <name>         local socket name, pqSocketBenchmark by default\n"
+           "  --external <host>     benchmark a running ParaView on <host>:<port> or\n"
+           "                        the local socket <name> instead of the echo handler\n"
+           "  --sizes <a,b,...>     payload sizes in bytes, 16,1024,65536,1048576\n"
+           "  --clients <a,b,...>   simultaneous clients, 1,4,16\n"
+           "  --messages <n>        messages per client for the throughput, 2000\n"
+           "  --roundtrips <n>      sequential requests per client for the latency, 200\n"
+           "  --window <n>          requests in flight per client, 32\n");
+    }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  pqSettings settings;
+  settings.Host = "127.0.0.1";
+  settings.Port = 19000;
+  settings.LocalName = "pqSocketBenchmark";
+  settings.Local = false;
+  settings.IOThread = false;
+  settings.External = false;
+  settings.Sizes << 16 << 1024 << 65536 << 1048576;
+  settings.Clients << 1 << 4 << 16;
+  settings.Messages = 2000;
+  settings.RoundTrips = 200;
+  settings.Window = 32;
+
+  QStringList arguments = app.arguments();
+  for (int i = 1; i < arguments.size(); ++i)
+    {
+    QString option = arguments[i];
+    QString value = i + 1 < arguments.size() ? arguments[i + 1] : QString();
+    if (option == "--local")
+      {
+      settings.Local = true;
+      continue;
+      }
+    if (option == "--io-thread")
+      {
+      settings.IOThread = true;
+      continue;
+      }
+    ++i;
+    if (option == "--port")
+      {
+      settings.Port = value.toInt();
+      }
+    else if (option == "--name")
+      {
+      settings.LocalName = value;
+      }
+    else if (option == "--external")
+      {
+      settings.External = true;
+      settings.Host = value;
+      }
+    else if (option == "--sizes")
+      {
+      settings.Sizes = parseList(value);
+      }
+    else if (option == "--clients")
+      {
+      settings.Clients = parseList(value);
+      }
+    else if (option == "--messages")
+      {
+      settings.Messages = value.toInt();
+      }
+    else if (option == "--roundtrips")
+      {
+      settings.RoundTrips = value.toInt();
+      }
+    else if (option == "--window")
+      {
+      settings.Window = qMax(1, value.toInt());
+      }
+    else
+      {
+      printUsage();
+      return option == "--help" ? 0 : 1;
+      }
+    }
+
+  // Declared first, the thread outlives the sockets of the endpoint.
+  QScopedPointer<pqSocketIOThread> ioThread(settings.IOThread ? new pqSocketIOThread(NULL) : 0);
+  pqSocketScheduler scheduler(NULL);
+  pqSocketEndpoint endpoint(NULL);
+  if (!settings.External)
+    {
+    endpoint.setHandler(new pqEchoSocketHandler(&endpoint));
+    endpoint.setScheduler(&scheduler);
+    endpoint.setIOThread(ioThread.data());
+    endpoint.setSocketType(settings.Local ? pqSocketEndpoint::LocalServerSocket
+                                          : pqSocketEndpoint::ServerSocket);
+    endpoint.setProtocol(pqSocketHandler::RequestProtocol);
+    endpoint.setAddress(QString(),
+                        settings.Local ? settings.LocalName : QString::number(settings.Port));
+    endpoint.setMaximumClients(256);
+    if (!endpoint.start())
+      {
+      fprintf(stderr, "%s\n", qPrintable(endpoint.errorString()));
+      return 1;
+      }
+    }
+
+  printf("%7s %8s %10s %9s %9s %10s %8s %9s\n", "clients", "size", "connect ms",
+         "rtt p50us", "rtt p99us", "msgs/s", "MB/s", "rss +KB");
+
+  foreach (int clientCount, settings.Clients)
+    {
+    foreach (int size, settings.Sizes)
+      {
+      qint64 memoryBefore = residentMemory();
+
+      QEventLoop loop;
+      QList<pqBenchmarkClient*> clients;
+      for (int i = 0; i < clientCount; ++i)
+        {
+        pqBenchmarkClient* client = new pqBenchmarkClient(settings, size);
+        QObject::connect(client, SIGNAL(finished()), &loop, SLOT(quit()));
+        clients.append(client);
+        client->start();
+        }
+
+      // The plugin side runs in this thread's event loop until every client
+      // is done.
+      bool running = true;
+      while (running)
+        {
+        running = false;
+        foreach (pqBenchmarkClient* client, clients)
+          {
+          running = running || !client->isFinished();
+          }
+        if (running)
+          {
+          loop.exec();
+          }
+        }
+
+      qint64 connectTime = 0;
+      qint64 throughputTime = 0;
+      quint64 messages = 0;
+      pqSocketHistogram roundTrip;
+      QString error;
+      foreach (pqBenchmarkClient* client, clients)
+        {
+        connectTime = qMax(connectTime, client->ConnectTime);
+        throughputTime = qMax(throughputTime, client->ThroughputTime);
+        messages += client->Replies;
+        roundTrip.merge(client->RoundTrip);
+        error = client->Error.isEmpty() ? error : client->Error;
+        delete client;
+        }
+
+      // Let the plugin notice the disconnects before the next run.
+      app.processEvents();
+
+      if (!error.isEmpty())
+        {
+        printf("%7d %8d  failed: %s\n", clientCount, size, qPrintable(error));
+        continue;
+        }
+
+      double seconds = throughputTime / 1e6;
+      printf("%7d %8d %10.2f %9lld %9lld %10.0f %8.1f %9s\n", clientCount, size,
+             connectTime / 1000.0,
+             roundTrip.percentile(0.5), roundTrip.percentile(0.99),
+             seconds > 0 ? messages / seconds : 0.0,
+             seconds > 0 ? messages * (size / 1048576.0) / seconds : 0.0,
+             settings.External ? "-"
+               : qPrintable(QString::number(residentMemory() - memoryBefore)));
+      fflush(stdout);
+      }
+    }
+
+  endpoint.stop();
+  return 0;
+}
@@ -0,0 +1,361 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqProxySocketHandler.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqProxySocketHandler.h"
+#include "pqSocketFetch.h"
+#include "pqSocketMessage.h"
+#include "pqSocketRenderThrottle.h"
+
+#include <pqActiveObjects.h>
+#include <pqApplicationCore.h>
+#include <pqPipelineSource.h>
+#include <pqServerManagerModel.h>
+#include <pqView.h>
+
+#include <vtkSMProperty.h>
+#include <vtkSMPropertyHelper.h>
+#include <vtkSMSourceProxy.h>
+
+#include <QVector>
+#include <QtEndian>
+
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+pqProxySocketHandler::pqProxySocketHandler(QObject* parent) : pqSocketHandler(parent)
+{
+  this->Position = NULL;
+  this->End = NULL;
+  this->RenderInterval = pqSocketRenderThrottle::ImmediateRender;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHandler* pqProxySocketHandler::newInstance(QObject* parent)
+{
+  return new pqProxySocketHandler(parent);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketOutputStream* pqProxySocketHandler::createStream(const pqSocketMessageHeader&,
+                                                         const char* payload, int payloadSize,
+                                                         QString& result, QString& error)
+{
+  return pqSocketFetch::create(payload, payloadSize, result, error);
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::configure(const QString& key, const QString& value)
+{
+  if (key == "render")
+    {
+    return pqSocketRenderThrottle::parseSetting(value, this->RenderInterval);
+    }
+  return pqSocketHandler::configure(key, value);
+}
+
+//-----------------------------------------------------------------------------
+void pqProxySocketHandler::executeMessage(const pqSocketMessageHeader& header,
+                                          const char* payload, int payloadSize)
+{
+  qint64 start = currentTime();
+  this->Position = reinterpret_cast<const uchar*>(payload);
+  this->End = this->Position + payloadSize;
+  this->Error.clear();
+
+  int executed = 0;
+  bool success = true;
+  while (success && this->Position < this->End)
+    {
+    int opcode = *this->Position++;
+    switch (opcode)
+      {
+      case SetPropertyCommand:
+        success = this->setProperty();
+        break;
+      case UpdatePipelineCommand:
+        success = this->updatePipeline();
+        break;
+      case SetCameraCommand:
+        success = this->setCamera();
+        break;
+      case RenderCommand:
+        success = this->render();
+        break;
+      default:
+        this->Error = QString("Unknown opcode %1.").arg(opcode);
+        success = false;
+      }
+    executed += success ? 1 : 0;
+    }
+
+  if (!success && this->Error.isEmpty())
+    {
+    this->Error = "The command is truncated.";
+    }
+  if (!success)
+    {
+    this->Error = QString("Command %1: %2").arg(executed + 1).arg(this->Error);
+    }
+
+  if (this->protocol() != RequestProtocol)
+    {
+    if (!success)
+      {
+      qWarning("Remote control: %s", qPrintable(this->Error));
+      }
+    return;
+    }
+
+  QByteArray reply = QString("{\"result\": %1, \"stdout\": \"\", \"stderr\": \"\", "
+                             "\"exception\": %2, \"time\": %3}")
+    .arg(executed)
+    .arg(success ? QString("null") : pqSocketJSONString(this->Error))
+    .arg((currentTime() - start) / 1e6).toUtf8();
+  this->writeMessage(pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::readString(QString& value)
+{
+  if (this->End - this->Position < 2)
+    {
+    return false;
+    }
+  int length = qFromBigEndian<quint16>(this->Position);
+  if (this->End - this->Position < 2 + length)
+    {
+    return false;
+    }
+  value = QString::fromUtf8(reinterpret_cast<const char*>(this->Position + 2), length);
+  this->Position += 2 + length;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::readDouble(double& value)
+{
+  if (this->End - this->Position < 8)
+    {
+    return false;
+    }
+  quint64 bits = qFromBigEndian<quint64>(this->Position);
+  memcpy(&value, &bits, sizeof(value));
+  this->Position += 8;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkSMProxy* pqProxySocketHandler::findSource(const QString& name)
+{
+  pqPipelineSource* source = name.isEmpty()
+    ? pqActiveObjects::instance().activeSource()
+    : pqApplicationCore::instance()->getServerManagerModel()->findItem<pqPipelineSource*>(name);
+  if (!source)
+    {
+    this->Error = name.isEmpty() ? QString("There is no active source.")
+                                 : QString("There is no source named '%1'.").arg(name);
+    return NULL;
+    }
+  return source->getProxy();
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::setProperty()
+{
+  QString proxyName;
+  QString propertyName;
+  if (!this->readString(proxyName) || !this->readString(propertyName)
+      || this->End - this->Position < 3)
+    {
+    return false;
+    }
+  int type = this->Position[0];
+  int count = qFromBigEndian<quint16>(this->Position + 1);
+  this->Position += 3;
+
+  // All values are read before touching the proxy, a truncated command
+  // leaves it unchanged.
+  QVector<double> doubles;
+  QVector<int> ints;
+  QList<QByteArray> strings;
+  for (int i = 0; i < count; ++i)
+    {
+    if (type == 0)
+      {
+      double value;
+      if (!this->readDouble(value))
+        {
+        return false;
+        }
+      doubles.append(value);
+      }
+    else if (type == 1)
+      {
+      if (this->End - this->Position < 4)
+        {
+        return false;
+        }
+      ints.append(qFromBigEndian<qint32>(this->Position));
+      this->Position += 4;
+      }
+    else if (type == 2)
+      {
+      QString value;
+      if (!this->readString(value))
+        {
+        return false;
+        }
+      strings.append(value.toUtf8());
+      }
+    else
+      {
+      this->Error = QString("Unknown value type %1.").arg(type);
+      return false;
+      }
+    }
+
+  vtkSMProxy* proxy = this->findSource(proxyName);
+  if (!proxy)
+    {
+    return false;
+    }
+  QByteArray property = propertyName.toAscii();
+  if (!proxy->GetProperty(property.constData()))
+    {
+    this->Error = QString("The proxy has no property '%1'.").arg(propertyName);
+    return false;
+    }
+
+  vtkSMPropertyHelper helper(proxy, property.constData());
+  if (type == 0)
+    {
+    helper.Set(doubles.constData(), count);
+    }
+  else if (type == 1)
+    {
+    helper.Set(ints.constData(), count);
+    }
+  else
+    {
+    helper.SetNumberOfElements(count);
+    for (int i = 0; i < count; ++i)
+      {
+      helper.Set(i, strings[i].constData());
+      }
+    }
+  proxy->UpdateVTKObjects();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::updatePipeline()
+{
+  QString proxyName;
+  double time;
+  if (!this->readString(proxyName) || !this->readDouble(time))
+    {
+    return false;
+    }
+
+  vtkSMSourceProxy* source = vtkSMSourceProxy::SafeDownCast(this->findSource(proxyName));
+  if (!source)
+    {
+    return false;
+    }
+  if (time != time)
+    {
+    source->UpdatePipeline();
+    }
+  else
+    {
+    source->UpdatePipeline(time);
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::setCamera()
+{
+  double values[10];
+  for (int i = 0; i < 10; ++i)
+    {
+    if (!this->readDouble(values[i]))
+      {
+      return false;
+      }
+    }
+
+  pqView* view = pqActiveObjects::instance().activeView();
+  vtkSMProxy* proxy = view ? view->getProxy() : NULL;
+  if (!proxy || !proxy->GetProperty("CameraPosition"))
+    {
+    this->Error = "The active view has no camera.";
+    return false;
+    }
+
+  vtkSMPropertyHelper(proxy, "CameraPosition").Set(values, 3);
+  vtkSMPropertyHelper(proxy, "CameraFocalPoint").Set(values + 3, 3);
+  vtkSMPropertyHelper(proxy, "CameraViewUp").Set(values + 6, 3);
+  vtkSMPropertyHelper(proxy, "CameraViewAngle").Set(0, values[9]);
+  proxy->UpdateVTKObjects();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool pqProxySocketHandler::render()
+{
+  if (this->Position >= this->End)
+    {
+    return false;
+    }
+  bool force = *this->Position++ != 0;
+
+  pqView* view = pqActiveObjects::instance().activeView();
+  if (!view)
+    {
+    this->Error = "There is no active view.";
+    return false;
+    }
+
+  // Unforced renders are merged, a stream of camera updates is drawn once
+  // per event loop turn, or per render interval, instead of once per message.
+  if (force)
+    {
+    pqSocketRenderThrottle::instance()->forceRender(view);
+    }
+  else
+    {
+    pqSocketRenderThrottle::instance()->requestRender(view, this->RenderInterval);
+    }
+  return true;
+}
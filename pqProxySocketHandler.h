@@ -0,0 +1,104 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqProxySocketHandler.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqProxySocketHandler_h
+#define _pqProxySocketHandler_h
+
+#include "pqSocketHandler.h"
+
+#include <QString>
+
+class vtkSMProxy;
+
+// Applies compact binary commands directly to server manager proxies,
+// without going through the python interpreter.  Meant for high rate
+// control such as camera tracking.  A message holds any number of commands,
+// each one an opcode byte followed by its big-endian arguments:
+//
+//   1 SetProperty     string proxy, string property, quint8 type (0 double,
+//                     1 int, 2 string), quint16 count, count values
+//   2 UpdatePipeline  string proxy, double time (NaN for the current time)
+//   3 SetCamera       double position[3], focal point[3], view up[3],
+//                     view angle
+//   4 Render          quint8 force, 0 lets ParaView coalesce renders
+//
+// Strings are a quint16 byte count followed by UTF-8.  Proxies are named as
+// in the pipeline browser, an empty name stands for the active source.  The
+// camera and render commands act on the active view.
+class pqProxySocketHandler : public pqSocketHandler
+{
+  Q_OBJECT
+
+public:
+
+  enum Opcode
+    {
+    SetPropertyCommand = 1,
+    UpdatePipelineCommand = 2,
+    SetCameraCommand = 3,
+    RenderCommand = 4
+    };
+
+  pqProxySocketHandler(QObject* parent);
+
+  virtual pqSocketHandler* newInstance(QObject* parent);
+
+protected:
+
+  virtual void executeMessage(const pqSocketMessageHeader& header,
+                              const char* payload, int payloadSize);
+
+  // Adds the render setting, see pqSocketRenderThrottle.
+  virtual bool configure(const QString& key, const QString& value);
+
+  // Answers FetchMessages with pqSocketFetch.
+  virtual pqSocketOutputStream* createStream(const pqSocketMessageHeader& header,
+                                             const char* payload, int payloadSize,
+                                             QString& result, QString& error);
+
+  // Each returns false with Error set when the command fails or its
+  // arguments run past the end of the message.
+  bool setProperty();
+  bool updatePipeline();
+  bool setCamera();
+  bool render();
+
+  bool readString(QString& value);
+  bool readDouble(double& value);
+  vtkSMProxy* findSource(const QString& name);
+
+  const uchar* Position;
+  const uchar* End;
+  QString Error;
+  int RenderInterval;
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonCodeCache.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include <vtkPython.h>
+
+#include "pqPythonCodeCache.h"
+
+#include <QCryptographicHash>
+
+//-----------------------------------------------------------------------------
+class pqPythonCodeCache::pqEntry
+{
+public:
+
+  pqEntry(PyObject* code) : Code(code) {}
+  ~pqEntry() {Py_DECREF(this->Code);}
+
+  PyObject* Code;
+};
+
+//-----------------------------------------------------------------------------
+pqPythonCodeCache::pqPythonCodeCache() : Cache(256)
+{
+  this->Hits = 0;
+  this->Misses = 0;
+}
+
+//-----------------------------------------------------------------------------
+pqPythonCodeCache::~pqPythonCodeCache()
+{
+  this->clear();
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonCodeCache::setMaximumEntries(int entries)
+{
+  this->Cache.setMaxCost(entries);
+}
+
+//-----------------------------------------------------------------------------
+int pqPythonCodeCache::maximumEntries() const
+{
+  return this->Cache.maxCost();
+}
+
+//-----------------------------------------------------------------------------
+int pqPythonCodeCache::entries() const
+{
+  return this->Cache.count();
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonCodeCache::clear()
+{
+  this->Cache.clear();
+}
+
+//-----------------------------------------------------------------------------
+PyObject* pqPythonCodeCache::compile(const char* source, int length, bool expression)
+{
+  QByteArray key = QCryptographicHash::hash(
+    QByteArray::fromRawData(source, length), QCryptographicHash::Sha1);
+  key.append(expression ? 'e' : 'x');
+
+  pqEntry* entry = this->Cache.object(key);
+  if (entry)
+    {
+    ++this->Hits;
+    Py_INCREF(entry->Code);
+    return entry->Code;
+    }
+
+  ++this->Misses;
+
+  // Py_CompileString needs a terminated string, the payload handed in by the
+  // receive buffer is not.
+  QByteArray terminated(source, length);
+  PyObject* code = NULL;
+  if (expression)
+    {
+    code = Py_CompileString(terminated.constData(), "<string>", Py_eval_input);
+    if (!code)
+      {
+      PyErr_Clear();
+      }
+    }
+  if (!code)
+    {
+    code = Py_CompileString(terminated.constData(), "<string>", Py_file_input);
+    }
+  if (!code)
+    {
+    return NULL;
+    }
+
+  Py_INCREF(code);
+  this->Cache.insert(key, new pqEntry(code));
+  return code;
+}
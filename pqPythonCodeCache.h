@@ -0,0 +1,77 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonCodeCache.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqPythonCodeCache_h
+#define _pqPythonCodeCache_h
+
+#include <QByteArray>
+#include <QCache>
+
+#ifndef PyObject_HEAD
+struct _object;
+typedef _object PyObject;
+#endif
+
+// Least recently used cache of compiled python code objects keyed by a hash
+// of the script source.  Scripts that are sent over and over are compiled
+// only once.  The interpreter must be current when calling compile() or
+// clear().
+class pqPythonCodeCache
+{
+public:
+
+  pqPythonCodeCache();
+  ~pqPythonCodeCache();
+
+  // Returns a new reference to the code object for the given source, or NULL
+  // with the python error indicator set if it does not compile.  With
+  // expression set, a source that is a single expression is compiled so that
+  // evaluating it returns its value.
+  PyObject* compile(const char* source, int length, bool expression=false);
+
+  void setMaximumEntries(int entries);
+  int maximumEntries() const;
+  int entries() const;
+
+  quint64 hits() const {return this->Hits;}
+  quint64 misses() const {return this->Misses;}
+
+  void clear();
+
+private:
+
+  class pqEntry;
+  QCache<QByteArray, pqEntry> Cache;
+  quint64 Hits;
+  quint64 Misses;
+};
+
+#endif
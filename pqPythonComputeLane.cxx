@@ -0,0 +1,260 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonComputeLane.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#include <vtkPython.h>
+
+#include "pqPythonComputeLane.h"
+#include "pqPythonInterrupt.h"
+#include "pqPythonSocketHandler.h"
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QMutex>
+#include <QPointer>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+
+namespace
+{
+  pqPythonComputeLane* Instance = 0;
+
+  // While jobs are pending the GUI thread gives up the interpreter lock for
+  // at most YieldSlice milliseconds every YieldInterval milliseconds.
+  const int YieldInterval = 10;
+  const int YieldSlice = 5;
+
+  // Signalled by the workers when a job finished, so that the GUI thread
+  // takes the lock back early.
+  QMutex FinishedMutex;
+  QWaitCondition Finished;
+
+  // One call.  Its thread state is created and deleted around the call so
+  // that none is left behind when the shell's interpreter is reset.
+  class pqComputeJob : public QRunnable
+  {
+  public:
+
+    pqComputeJob(int id, quint32 connectionId, quint32 requestId,
+                 PyInterpreterState* interpreter, PyObject* function, PyObject* arguments)
+      {
+      this->Id = id;
+      this->ConnectionId = connectionId;
+      this->RequestId = requestId;
+      this->Interpreter = interpreter;
+      this->Function = function;
+      this->Arguments = arguments;
+      Py_INCREF(this->Function);
+      Py_INCREF(this->Arguments);
+      }
+
+    virtual void run()
+      {
+      PyThreadState* state = PyThreadState_New(this->Interpreter);
+      PyEval_AcquireThread(state);
+
+      // Errors are not printed, sys.stderr belongs to the GUI thread.
+      QByteArray reply;
+      if (pqPythonInterrupt::begin(this->ConnectionId, this->RequestId))
+        {
+        PyObject* result = PyObject_CallObject(this->Function, this->Arguments);
+        pqPythonInterrupt::end(this->ConnectionId, this->RequestId);
+        char* buffer;
+        Py_ssize_t length;
+        if (result && PyString_Check(result)
+            && !PyString_AsStringAndSize(result, &buffer, &length))
+          {
+          reply = QByteArray(buffer, static_cast<int>(length));
+          }
+        PyErr_Clear();
+        Py_XDECREF(result);
+        }
+      else
+        {
+        reply = QString("{\"result\": null, \"stdout\": \"\", \"stderr\": \"\", "
+                        "\"exception\": %1, \"time\": 0}")
+          .arg(pqSocketJSONString("The request was cancelled before it started.")).toUtf8();
+        }
+      Py_DECREF(this->Function);
+      Py_DECREF(this->Arguments);
+
+      PyThreadState_Clear(state);
+      PyThreadState_DeleteCurrent();
+
+      QMetaObject::invokeMethod(Instance, "onJobFinished", Qt::QueuedConnection,
+                                Q_ARG(int, this->Id), Q_ARG(QByteArray, reply));
+      FinishedMutex.lock();
+      Finished.wakeAll();
+      FinishedMutex.unlock();
+      }
+
+  private:
+
+    int Id;
+    quint32 ConnectionId;
+    quint32 RequestId;
+    PyInterpreterState* Interpreter;
+    PyObject* Function;
+    PyObject* Arguments;
+  };
+}
+
+//-----------------------------------------------------------------------------
+class pqPythonComputeLane::pqInternal
+{
+public:
+
+  struct pqJob
+    {
+    QPointer<pqPythonSocketHandler> Handler;
+    pqSocketMessageHeader Header;
+    };
+
+  QThreadPool Pool;
+  QMap<int, pqJob> Jobs;
+  int NextJob;
+  quint64 Completed;
+  QTimer YieldTimer;
+};
+
+//-----------------------------------------------------------------------------
+pqPythonComputeLane* pqPythonComputeLane::instance()
+{
+  if (!Instance)
+    {
+    Instance = new pqPythonComputeLane(QCoreApplication::instance());
+    }
+  return Instance;
+}
+
+//-----------------------------------------------------------------------------
+pqPythonComputeLane::pqPythonComputeLane(QObject* parent) : QObject(parent)
+{
+  this->Internal = new pqInternal;
+  this->Internal->NextJob = 0;
+  this->Internal->Completed = 0;
+  this->Internal->YieldTimer.setInterval(YieldInterval);
+  this->connect(&this->Internal->YieldTimer, SIGNAL(timeout()), SLOT(yieldInterpreter()));
+}
+
+//-----------------------------------------------------------------------------
+pqPythonComputeLane::~pqPythonComputeLane()
+{
+  // Queued jobs are dropped, running ones need the lock to finish.
+  this->Internal->Pool.clear();
+  PyThreadState* state = this->Internal->Jobs.isEmpty() ? NULL : PyThreadState_Swap(NULL);
+  if (state)
+    {
+    PyEval_ReleaseLock();
+    }
+  this->Internal->Pool.waitForDone();
+  if (state)
+    {
+    PyEval_AcquireLock();
+    PyThreadState_Swap(state);
+    }
+  Instance = 0;
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonComputeLane::submit(pqPythonSocketHandler* handler,
+                                 const pqSocketMessageHeader& header,
+                                 PyObject* function, PyObject* arguments)
+{
+  // Creates the interpreter lock the first time, held by this thread.
+  PyEval_InitThreads();
+
+  int id = this->Internal->NextJob++;
+  pqInternal::pqJob& job = this->Internal->Jobs[id];
+  job.Handler = handler;
+  job.Header = header;
+  pqPythonInterrupt::queue(handler->connectionId(), header.RequestId);
+  int priority =
+    (header.Flags & pqSocketMessageHeader::PriorityMask) >> pqSocketMessageHeader::PriorityShift;
+  this->Internal->Pool.start(new pqComputeJob(id, handler->connectionId(), header.RequestId,
+                                              PyThreadState_Get()->interp, function, arguments),
+                             priority);
+  this->Internal->YieldTimer.start();
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonComputeLane::yieldInterpreter()
+{
+  // Same as PyEval_SaveThread() and PyEval_RestoreThread(), which abort
+  // when no thread state is current.
+  PyThreadState* state = PyThreadState_Swap(NULL);
+  if (!state)
+    {
+    return;
+    }
+  FinishedMutex.lock();
+  PyEval_ReleaseLock();
+  Finished.wait(&FinishedMutex, YieldSlice);
+  FinishedMutex.unlock();
+  PyEval_AcquireLock();
+  PyThreadState_Swap(state);
+
+  // Cancelled jobs are otherwise interrupted when the GUI thread next runs
+  // a script.
+  if (!PyEval_GetFrame())
+    {
+    pqPythonInterrupt::deliver();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonComputeLane::onJobFinished(int id, const QByteArray& reply)
+{
+  pqInternal::pqJob job = this->Internal->Jobs.take(id);
+  this->Internal->Completed++;
+  if (this->Internal->Jobs.isEmpty())
+    {
+    this->Internal->YieldTimer.stop();
+    }
+  if (job.Handler)
+    {
+    job.Handler->writeComputeReply(job.Header, reply);
+    }
+}
+
+//-----------------------------------------------------------------------------
+int pqPythonComputeLane::pendingJobs() const
+{
+  return this->Internal->Jobs.size();
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqPythonComputeLane::completedJobs() const
+{
+  return this->Internal->Completed;
+}
@@ -0,0 +1,89 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonComputeLane.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqPythonComputeLane_h
+#define _pqPythonComputeLane_h
+
+#include "pqSocketMessage.h"
+
+#include <QObject>
+
+class pqPythonSocketHandler;
+
+#ifndef PyObject_HEAD
+struct _object;
+typedef _object PyObject;
+#endif
+
+// Runs the scripts flagged with ComputeFlag in a pool of worker threads, so
+// that long analyses which never touch views or proxies do not hold up the
+// messages of other connections.  Each job gets a thread state of its own in
+// the interpreter of the python shell.  The GUI thread holds the interpreter
+// lock whenever it is idle, so while jobs are pending it hands the lock over
+// for a few milliseconds at a time; numpy and VTK kernels release the lock
+// themselves and keep running in between.  Replies are written back on the
+// GUI thread.
+class pqPythonComputeLane : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  static pqPythonComputeLane* instance();
+
+  // Calls the python function with the argument tuple in a worker thread.
+  // The function returns the JSON reply to the request, which is passed to
+  // the handler unless it was deleted in the meantime.  Must be called with
+  // the shell current.
+  void submit(pqPythonSocketHandler* handler, const pqSocketMessageHeader& header,
+              PyObject* function, PyObject* arguments);
+
+  // Jobs queued or running, and jobs completed since startup.
+  int pendingJobs() const;
+  quint64 completedJobs() const;
+
+protected slots:
+
+  void onJobFinished(int job, const QByteArray& reply);
+  void yieldInterpreter();
+
+protected:
+
+  pqPythonComputeLane(QObject* parent);
+  virtual ~pqPythonComputeLane();
+
+private:
+
+  class pqInternal;
+  pqInternal* Internal;
+};
+
+#endif
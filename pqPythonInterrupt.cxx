@@ -0,0 +1,171 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonInterrupt.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#include <vtkPython.h>
+
+#include "pqPythonInterrupt.h"
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace
+{
+  struct pqRequest
+    {
+    quint32 Connection;
+    quint32 Request;
+    // Thread and interpreter of the script, 0 while it is queued.
+    long Thread;
+    PyInterpreterState* Interpreter;
+    bool Cancelled;
+    bool Delivered;
+    };
+
+  QMutex Mutex;
+  QList<pqRequest> Requests;
+
+  int indexOf(quint32 connectionId, quint32 requestId)
+    {
+    for (int i = 0; i < Requests.size(); ++i)
+      {
+      if (Requests[i].Connection == connectionId && Requests[i].Request == requestId)
+        {
+        return i;
+        }
+      }
+    return -1;
+    }
+
+  // Runs with the interpreter lock held.  An exception returned from a
+  // pending call is raised in the code that the GUI thread is running.
+  int deliverInterrupts(void*)
+    {
+    QMutexLocker locker(&Mutex);
+    int result = 0;
+    long current = PyThread_get_thread_ident();
+    for (int i = 0; i < Requests.size(); ++i)
+      {
+      pqRequest& request = Requests[i];
+      if (!request.Cancelled || request.Delivered || !request.Thread)
+        {
+        continue;
+        }
+      request.Delivered = true;
+      if (request.Thread == current)
+        {
+        PyErr_SetString(PyExc_KeyboardInterrupt, "Cancelled by the client.");
+        result = -1;
+        continue;
+        }
+
+      // PyThreadState_SetAsyncExc() looks for the thread in the interpreter
+      // of the current thread state.
+      PyThreadState* state = PyThreadState_New(request.Interpreter);
+      PyThreadState* previous = PyThreadState_Swap(state);
+      PyThreadState_SetAsyncExc(request.Thread, PyExc_KeyboardInterrupt);
+      PyThreadState_Swap(previous);
+      PyThreadState_Clear(state);
+      PyThreadState_Delete(state);
+      }
+    return result;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonInterrupt::queue(quint32 connectionId, quint32 requestId)
+{
+  QMutexLocker locker(&Mutex);
+  pqRequest request = {connectionId, requestId, 0, 0, false, false};
+  Requests.append(request);
+}
+
+//-----------------------------------------------------------------------------
+bool pqPythonInterrupt::begin(quint32 connectionId, quint32 requestId)
+{
+  QMutexLocker locker(&Mutex);
+  int index = indexOf(connectionId, requestId);
+  if (index < 0)
+    {
+    pqRequest request = {connectionId, requestId, 0, 0, false, false};
+    Requests.append(request);
+    index = Requests.size() - 1;
+    }
+  else if (Requests[index].Cancelled)
+    {
+    Requests.removeAt(index);
+    return false;
+    }
+  Requests[index].Thread = PyThread_get_thread_ident();
+  Requests[index].Interpreter = PyThreadState_Get()->interp;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonInterrupt::end(quint32 connectionId, quint32 requestId)
+{
+  QMutexLocker locker(&Mutex);
+  int index = indexOf(connectionId, requestId);
+  if (index >= 0)
+    {
+    Requests.removeAt(index);
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqPythonInterrupt::interrupt(quint32 connectionId, quint32 requestId)
+{
+  QMutexLocker locker(&Mutex);
+  int index = indexOf(connectionId, requestId);
+  if (index < 0)
+    {
+    return false;
+    }
+  pqRequest& request = Requests[index];
+  if (!request.Cancelled)
+    {
+    request.Cancelled = true;
+    if (request.Thread)
+      {
+      Py_AddPendingCall(&deliverInterrupts, NULL);
+      }
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonInterrupt::deliver()
+{
+  if (deliverInterrupts(NULL) < 0)
+    {
+    PyErr_Clear();
+    }
+}
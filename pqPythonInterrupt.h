@@ -0,0 +1,66 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqPythonInterrupt.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqPythonInterrupt_h
+#define _pqPythonInterrupt_h
+
+#include <QtGlobal>
+
+// Interrupts the python scripts answering requests.  Scripts are registered
+// with their connection and request while they are queued or running.  A
+// queued script is skipped.  For a running one a pending call is scheduled
+// with Py_AddPendingCall(), which the interpreter runs in the GUI thread
+// between two bytecodes and which raises KeyboardInterrupt in the thread of
+// the script.  A script busy in C code, such as a filter update, stops once
+// it is back in python.
+class pqPythonInterrupt
+{
+public:
+
+  // Registers a script of the compute lane that waits for a thread.
+  static void queue(quint32 connectionId, quint32 requestId);
+
+  // Called with the interpreter lock held by the thread that runs the
+  // script, around the script.  Returns false if the script was cancelled
+  // while it was queued, it must not run then.
+  static bool begin(quint32 connectionId, quint32 requestId);
+  static void end(quint32 connectionId, quint32 requestId);
+
+  // A pqSocketHandler::InterruptFunction, safe to call from any thread.
+  static bool interrupt(quint32 connectionId, quint32 requestId);
+
+  // Interrupts the scripts of worker threads right away.  Called with the
+  // interpreter lock held by the GUI thread while it runs no python code,
+  // when the pending call would wait for the next script.
+  static void deliver();
+};
+
+#endif
@@ -33,85 +33,917 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vtkPython.h>
 
 #include "pqPythonSocketHandler.h"
+#include "pqPythonCodeCache.h"
+#include "pqPythonComputeLane.h"
+#include "pqPythonInterrupt.h"
+#include "pqSharedArrayCache.h"
+#include "pqSocketFetch.h"
+#include "pqSocketImageEncoder.h"
+#include "pqSocketMessage.h"
+#include "pqSocketRenderThrottle.h"
+#include "pqSocketSweep.h"
 
+#include <pqActiveObjects.h>
+#include <pqApplicationCore.h>
 #include <pqPVApplicationCore.h>
 #include <pqPythonManager.h>
 #include <pqPythonDialog.h>
 #include <pqPythonShell.h>
+#include <pqServerManagerModel.h>
+#include <pqView.h>
 
-#include <QTcpSocket>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPythonUtil.h>
+#include <vtkSMProxy.h>
+#include <vtkType.h>
+
+#include <QtEndian>
+
+#include <string.h>
+
+namespace
+{
+  // Multiplies product by factor unless the result would exceed limit.
+  bool multiplyWithin(qint64& product, quint64 factor, qint64 limit)
+    {
+    if (factor && static_cast<quint64>(product) > static_cast<quint64>(limit) / factor)
+      {
+      return false;
+      }
+    product *= static_cast<qint64>(factor);
+    return true;
+    }
+
+  // Loaded once into the module _paraview_remote.  Scripts arrive already
+  // compiled, see pqPythonCodeCache.  _handler runs them in the namespace of
+  // their connection, __main__ unless the connection asked for an isolated
+  // one, and with reply set returns the reply to a request as a JSON string.
+  // A script that is sent often can instead be registered once under a name
+  // and then run with remote_run(name, key=value, ...), which only costs
+  // compiling the short call; the keyword arguments are visible to the
+  // script as 'args'.  When the connection defers renders, Render() in the
+  // script's namespace only records the view while the script runs and is
+  // restored afterwards, paraview.simple itself is left alone.
+  // _take_renders hands the recorded views to the render throttle.
+  // _compute runs a script in a worker thread of pqPythonComputeLane; the
+  // output of each thread is captured separately and only the GUI thread
+  // echoes it to the shell.
+  const char* DispatcherSource =
+    "import threading as _threading\n"
+    "\n"
+    "class _RemoteOutput(object):\n"
+    "    def __init__(self, stream):\n"
+    "        self.stream = stream\n"
+    "        self.parts = []\n"
+    "    def write(self, text):\n"
+    "        if self.stream is not None:\n"
+    "            self.stream.write(text)\n"
+    "        if not isinstance(text, unicode):\n"
+    "            text = text.decode('utf-8', 'replace')\n"
+    "        self.parts.append(text)\n"
+    "    def flush(self):\n"
+    "        getattr(self.stream, 'flush', lambda: None)()\n"
+    "    def getvalue(self):\n"
+    "        return u''.join(self.parts)\n"
+    "\n"
+    "_captures = _threading.local()\n"
+    "\n"
+    "class _ThreadStream(object):\n"
+    "    def __init__(self, stream, name):\n"
+    "        self.stream = stream\n"
+    "        self.name = name\n"
+    "    def write(self, text):\n"
+    "        (getattr(_captures, self.name, None) or self.stream).write(text)\n"
+    "    def flush(self):\n"
+    "        getattr(self.stream, 'flush', lambda: None)()\n"
+    "    def __getattr__(self, name):\n"
+    "        return getattr(self.stream, name)\n"
+    "\n"
+    "def _capture(echo):\n"
+    "    import sys\n"
+    "    for name in ('stdout', 'stderr'):\n"
+    "        stream = getattr(sys, name)\n"
+    "        if not isinstance(stream, _ThreadStream):\n"
+    "            stream = _ThreadStream(stream, name)\n"
+    "            setattr(sys, name, stream)\n"
+    "        setattr(_captures, name, _RemoteOutput(stream.stream if echo else None))\n"
+    "    return _captures.stdout, _captures.stderr\n"
+    "\n"
+    "def _handler(code, reply=False, namespace=None, defer_renders=False):\n"
+    "    global _defer_renders\n"
+    "    if namespace is None:\n"
+    "        import __main__\n"
+    "        namespace = __main__.__dict__\n"
+    "    wrapped = defer_renders and _wrap_render(namespace)\n"
+    "    _defer_renders = defer_renders\n"
+    "    try:\n"
+    "        return _execute(code, reply, namespace, True)\n"
+    "    finally:\n"
+    "        _defer_renders = False\n"
+    "        if wrapped and namespace.get('Render') is _remote_render:\n"
+    "            namespace['Render'] = _simple_render\n"
+    "\n"
+    "def _compute(code, namespace=None):\n"
+    "    if namespace is None:\n"
+    "        import __main__\n"
+    "        namespace = __main__.__dict__\n"
+    "    return _execute(code, True, namespace, False)\n"
+    "\n"
+    "def _execute(code, reply, namespace, echo):\n"
+    "    import sys, time, traceback\n"
+    "    if 'remote_run' not in namespace:\n"
+    "        _install(namespace)\n"
+    "    if reply:\n"
+    "        output, errors = _capture(echo)\n"
+    "    result, exception = None, None\n"
+    "    start = time.time()\n"
+    "    try:\n"
+    "        try:\n"
+    "            if isinstance(code, str):\n"
+    "                code = compile(code, '<string>', 'exec')\n"
+    "            result = eval(code, namespace)\n"
+    "        except:\n"
+    "            exception = traceback.format_exc()\n"
+    "            if echo:\n"
+    "                getattr(sys.stderr, 'stream', sys.stderr).write(exception)\n"
+    "    finally:\n"
+    "        elapsed = time.time() - start\n"
+    "        _captures.stdout = _captures.stderr = None\n"
+    "    if not reply:\n"
+    "        return None\n"
+    "    import json\n"
+    "    try:\n"
+    "        json.dumps(result)\n"
+    "    except:\n"
+    "        result = repr(result)\n"
+    "    return json.dumps({'result': result, 'stdout': output.getvalue(),\n"
+    "        'stderr': errors.getvalue(), 'exception': exception, 'time': elapsed})\n"
+    "\n"
+    "_remote_scripts = {}\n"
+    "\n"
+    "def remote_register(name, source):\n"
+    "    _remote_scripts[name] = compile(source, name, 'exec')\n"
+    "\n"
+    "def remote_unregister(name):\n"
+    "    _remote_scripts.pop(name, None)\n"
+    "\n"
+    "def remote_run(name, **args):\n"
+    "    import sys\n"
+    "    namespace = sys._getframe(1).f_globals\n"
+    "    namespace['args'] = args\n"
+    "    exec(_remote_scripts[name], namespace)\n"
+    "\n"
+    "_simple_render = None\n"
+    "_defer_renders = False\n"
+    "_pending_renders = []\n"
+    "\n"
+    "def _remote_render(view=None, force=False, **params):\n"
+    "    from paraview import simple\n"
+    "    if view is None:\n"
+    "        view = simple.GetActiveView()\n"
+    "    first = getattr(getattr(simple, '_funcs_internals', None), 'first_render', False)\n"
+    "    if force or first or not _defer_renders or view is None:\n"
+    "        if view is not None and view.SMProxy in _pending_renders:\n"
+    "            _pending_renders.remove(view.SMProxy)\n"
+    "        return _simple_render(view, **params)\n"
+    "    if params:\n"
+    "        simple.SetProperties(view, **params)\n"
+    "    if view.SMProxy not in _pending_renders:\n"
+    "        _pending_renders.append(view.SMProxy)\n"
+    "    return view\n"
+    "\n"
+    "def _wrap_render(namespace):\n"
+    "    global _simple_render\n"
+    "    try:\n"
+    "        from paraview import simple\n"
+    "    except ImportError:\n"
+    "        return False\n"
+    "    _simple_render = simple.Render\n"
+    "    if namespace.get('Render') is not _simple_render:\n"
+    "        return False\n"
+    "    namespace['Render'] = _remote_render\n"
+    "    return True\n"
+    "\n"
+    "def _take_renders():\n"
+    "    views = _pending_renders[:]\n"
+    "    del _pending_renders[:]\n"
+    "    return views\n"
+    "\n"
+    "remote_arrays = {}\n"
+    "_remote_array_objects = {}\n"
+    "\n"
+    "def _install(namespace):\n"
+    "    namespace.update(remote_register=remote_register,\n"
+    "        remote_unregister=remote_unregister, remote_run=remote_run,\n"
+    "        remote_arrays=remote_arrays)\n"
+    "\n"
+    "def _new_namespace():\n"
+    "    namespace = {'__name__': '__remote__', '__builtins__': __builtins__}\n"
+    "    try:\n"
+    "        exec('from paraview.simple import *', namespace)\n"
+    "    except ImportError:\n"
+    "        pass\n"
+    "    _install(namespace)\n"
+    "    return namespace\n"
+    "\n"
+    "def _clear_namespace(namespace):\n"
+    "    import gc\n"
+    "    namespace.clear()\n"
+    "    gc.collect()\n"
+    "\n"
+    "def _receive_array(name, array, shape):\n"
+    "    import json\n"
+    "    view = array\n"
+    "    try:\n"
+    "        try:\n"
+    "            from paraview.vtk.util.numpy_support import vtk_to_numpy\n"
+    "        except ImportError:\n"
+    "            from vtk.util.numpy_support import vtk_to_numpy\n"
+    "        view = vtk_to_numpy(array)\n"
+    "        view = view.reshape(tuple(shape) + view.shape[1:])\n"
+    "    except ImportError:\n"
+    "        pass\n"
+    "    remote_arrays[name] = view\n"
+    "    _remote_array_objects[name] = array\n"
+    "    return json.dumps({'result': name, 'stdout': '', 'stderr': '',\n"
+    "        'exception': None, 'time': 0})\n";
+}
 
 //-----------------------------------------------------------------------------
 class pqPythonSocketHandler::pqInternal
 {
 public:
 
-  PyObject* Callback;
+  pqInternal()
+    {
+    this->Namespace = 0;
+    this->InBatch = false;
+    this->RenderInterval = pqSocketRenderThrottle::ImmediateRender;
+    this->Sweep = 0;
+    }
+
+  // Returns a borrowed reference to a function of the dispatcher, loading it
+  // if this is the first use or the shell was reset since.
+  static PyObject* dispatcher(const char* name)
+    {
+    PyObject* module = PyImport_AddModule("_paraview_remote");
+    if (!module)
+      {
+      return NULL;
+      }
+    PyObject* dict = PyModule_GetDict(module);
+    if (!PyDict_GetItemString(dict, "_handler"))
+      {
+      PyDict_SetItemString(dict, "__builtins__", PyEval_GetBuiltins());
+      PyObject* result = PyRun_String(DispatcherSource, Py_file_input, dict, dict);
+      if (!result)
+        {
+        return NULL;
+        }
+      Py_DECREF(result);
+      }
+    return PyDict_GetItemString(dict, name);
+    }
+
+  // Drops the isolated namespace, clearing it first so that its objects are
+  // released now rather than whenever the namespace itself is collected.
+  void clearNamespace()
+    {
+    if (!this->Namespace)
+      {
+      return;
+      }
+    PyObject* clear = dispatcher("_clear_namespace");
+    PyObject* result = clear
+      ? PyObject_CallFunctionObjArgs(clear, this->Namespace, NULL) : NULL;
+    if (!result)
+      {
+      PyErr_Print();
+      }
+    Py_XDECREF(result);
+    Py_DECREF(this->Namespace);
+    this->Namespace = 0;
+    }
+
+  // The shell is made current once for a whole batch of messages.  Nested
+  // acquisitions only count, the outermost one switches the interpreter.
+  static void acquireShell()
+    {
+    if (!ShellDepth++)
+      {
+      pqPVApplicationCore::instance()->pythonManager()->pythonShellDialog()->shell()->makeCurrent();
+      ++ShellAcquisitions;
+      }
+    }
+
+  static void releaseShell()
+    {
+    if (!--ShellDepth)
+      {
+      pqPVApplicationCore::instance()->pythonManager()->pythonShellDialog()->shell()->releaseControl();
+      }
+    }
+
+  // Globals of this connection's scripts, NULL for the shared __main__.
+  PyObject* Namespace;
+  bool InBatch;
+  int RenderInterval;
+  pqSocketImageEncoder ImageEncoder;
+
+  // The running sweep, a child of the handler, and its request.
+  pqSocketSweep* Sweep;
+  pqSocketMessageHeader SweepHeader;
+
+  static int ShellDepth;
+  static quint64 ShellAcquisitions;
+  static quint64 ExecutedScripts;
+
+  // Compiled scripts are shared by every connection.
+  static pqPythonCodeCache* CodeCache;
+  static int CodeCacheUsers;
+
+  // Mapped shared memory arrays, shared like the code cache.
+  static pqSharedArrayCache* SharedArrays;
 };
 
+pqPythonCodeCache* pqPythonSocketHandler::pqInternal::CodeCache = 0;
+int pqPythonSocketHandler::pqInternal::CodeCacheUsers = 0;
+pqSharedArrayCache* pqPythonSocketHandler::pqInternal::SharedArrays = 0;
+int pqPythonSocketHandler::pqInternal::ShellDepth = 0;
+quint64 pqPythonSocketHandler::pqInternal::ShellAcquisitions = 0;
+quint64 pqPythonSocketHandler::pqInternal::ExecutedScripts = 0;
+
 //-----------------------------------------------------------------------------
 pqPythonSocketHandler::pqPythonSocketHandler(QObject* parent) : pqSocketHandler(parent)
 {
   this->Internal = new pqInternal;
 
-  pqPythonShell* shell = pqPVApplicationCore::instance()->pythonManager()->pythonShellDialog()->shell();
-  shell->makeCurrent();
+  if (!pqInternal::CodeCacheUsers++)
+    {
+    pqInternal::CodeCache = new pqPythonCodeCache;
+    pqInternal::SharedArrays = new pqSharedArrayCache;
+    pqSocketHandler::setInterruptFunction(&pqPythonInterrupt::interrupt);
+    }
+}
 
-  PyRun_SimpleString(
-    "def _handler(s):\n"
-    "    try:\n"
-    "        code = compile(s, '<string>', 'exec')\n"
-    "        exec(code, globals())\n"
-    "    except:\n"
-    "        import traceback\n"
-    "        traceback.print_exc()\n");
+//-----------------------------------------------------------------------------
+pqPythonSocketHandler::~pqPythonSocketHandler()
+{
+  if (this->Internal->InBatch)
+    {
+    this->endBatch();
+    }
+  if (this->Internal->Namespace)
+    {
+    pqInternal::acquireShell();
+    this->Internal->clearNamespace();
+    pqInternal::releaseShell();
+    }
+  if (!--pqInternal::CodeCacheUsers)
+    {
+    // The cache releases its code objects, which needs the interpreter.
+    pqInternal::acquireShell();
+    delete pqInternal::CodeCache;
+    pqInternal::CodeCache = 0;
+    pqInternal::releaseShell();
+    delete pqInternal::SharedArrays;
+    pqInternal::SharedArrays = 0;
+    }
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+pqPythonCodeCache* pqPythonSocketHandler::codeCache()
+{
+  return pqInternal::CodeCache;
+}
 
-  PyObject* mainModule = PyImport_AddModule("__main__");
-  PyObject* mainDict = PyModule_GetDict(mainModule);
-  this->Internal->Callback = PyDict_GetItemString(mainDict, "_handler");
-  Py_INCREF(this->Internal->Callback);
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::setCodeCacheSize(int scripts)
+{
+  // Evicted code objects are released, which needs the interpreter.
+  if (pqInternal::CodeCache)
+    {
+    pqInternal::acquireShell();
+    pqInternal::CodeCache->setMaximumEntries(scripts);
+    pqInternal::releaseShell();
+    }
+}
 
-  shell->releaseControl();
+//-----------------------------------------------------------------------------
+quint64 pqPythonSocketHandler::shellAcquisitions()
+{
+  return pqInternal::ShellAcquisitions;
 }
 
 //-----------------------------------------------------------------------------
-pqPythonSocketHandler::~pqPythonSocketHandler()
+quint64 pqPythonSocketHandler::executedScripts()
 {
-  Py_DECREF(this->Internal->Callback);
-  delete this->Internal;
+  return pqInternal::ExecutedScripts;
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::beginBatch()
+{
+  if (!this->Internal->InBatch)
+    {
+    this->Internal->InBatch = true;
+    pqInternal::acquireShell();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::endBatch()
+{
+  if (this->Internal->InBatch)
+    {
+    this->Internal->InBatch = false;
+    pqInternal::releaseShell();
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHandler* pqPythonSocketHandler::newInstance(QObject* parent)
+{
+  return new pqPythonSocketHandler(parent);
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::executeMessage(const pqSocketMessageHeader& header,
+                                           const char* payload, int payloadSize)
+{
+  bool reply = this->protocol() == RequestProtocol;
+
+  if (reply && (header.Type == pqSocketMessageHeader::ArrayMessage
+                || header.Type == pqSocketMessageHeader::SharedArrayMessage))
+    {
+    this->receiveArray(header, payload, payloadSize);
+    return;
+    }
+  if (reply && header.Type == pqSocketMessageHeader::SweepMessage)
+    {
+    this->executeSweep(header, payload, payloadSize);
+    return;
+    }
+  if (reply && header.Type != pqSocketMessageHeader::ScriptMessage)
+    {
+    this->writeErrorReply(header, QString("Unsupported message type %1.").arg(header.Type));
+    return;
+    }
+
+  pqInternal::acquireShell();
+  ++pqInternal::ExecutedScripts;
+
+  // A script that does not compile is handed over as source so that the
+  // syntax error is reported like any other exception.
+  qint64 start = currentTime();
+  quint64 hits = pqInternal::CodeCache->hits();
+  PyObject* code = pqInternal::CodeCache->compile(payload, payloadSize, reply);
+  this->statistics().Compile.add(currentTime() - start);
+  if (pqInternal::CodeCache->hits() != hits)
+    {
+    this->statistics().CodeCacheHits++;
+    }
+  else
+    {
+    this->statistics().CodeCacheMisses++;
+    }
+  if (!code)
+    {
+    PyErr_Clear();
+    code = PyString_FromStringAndSize(payload, payloadSize);
+    }
+
+  // The reply of a compute script is written by writeComputeReply() once the
+  // worker is done, images are not sent since it does not render.
+  if (reply && (header.Flags & pqSocketMessageHeader::ComputeFlag))
+    {
+    PyObject* compute = pqInternal::dispatcher("_compute");
+    if (compute)
+      {
+      PyObject* arguments = Py_BuildValue(const_cast<char*>("(OO)"), code,
+        this->Internal->Namespace ? this->Internal->Namespace : Py_None);
+      pqPythonComputeLane::instance()->submit(this, header, compute, arguments);
+      Py_DECREF(arguments);
+      }
+    else
+      {
+      this->writeReply(header, NULL);
+      }
+    Py_DECREF(code);
+    pqInternal::releaseShell();
+    return;
+    }
+
+  // A request can be interrupted by a CancelMessage while it runs.
+  if (reply)
+    {
+    pqPythonInterrupt::begin(this->connectionId(), header.RequestId);
+    }
+  bool deferRenders = this->Internal->RenderInterval != pqSocketRenderThrottle::ImmediateRender;
+  PyObject* handler = pqInternal::dispatcher("_handler");
+  PyObject* returnValue = handler ? PyObject_CallFunction(handler, const_cast<char*>("OiOi"),
+    code, static_cast<int>(reply),
+    this->Internal->Namespace ? this->Internal->Namespace : Py_None,
+    static_cast<int>(deferRenders)) : NULL;
+  if (reply)
+    {
+    pqPythonInterrupt::end(this->connectionId(), header.RequestId);
+    }
+  Py_DECREF(code);
+  this->writeReply(header, returnValue);
+  if (deferRenders)
+    {
+    this->requestRenders();
+    }
+
+  if (reply && (header.Flags & pqSocketMessageHeader::SendImageFlag))
+    {
+    this->sendImage(header);
+    }
+
+  pqInternal::releaseShell();
+}
+
+//-----------------------------------------------------------------------------
+pqSocketOutputStream* pqPythonSocketHandler::createStream(const pqSocketMessageHeader&,
+                                                          const char* payload, int payloadSize,
+                                                          QString& result, QString& error)
+{
+  return pqSocketFetch::create(payload, payloadSize, result, error);
+}
+
+//-----------------------------------------------------------------------------
+bool pqPythonSocketHandler::configure(const QString& key, const QString& value)
+{
+  if (key == "render")
+    {
+    return pqSocketRenderThrottle::parseSetting(value, this->Internal->RenderInterval);
+    }
+  if (key != "namespace")
+    {
+    return pqSocketHandler::configure(key, value);
+    }
+  if (value != "shared" && value != "isolated" && value != "reset")
+    {
+    return false;
+    }
+
+  // Resetting an isolated namespace replaces it with a fresh one, resetting
+  // the shared one is refused since other connections use it.
+  bool isolate = value == "isolated" || (value == "reset" && this->Internal->Namespace);
+  if (value == "reset" && !isolate)
+    {
+    return false;
+    }
+
+  pqInternal::acquireShell();
+  this->Internal->clearNamespace();
+  bool success = true;
+  if (isolate)
+    {
+    PyObject* create = pqInternal::dispatcher("_new_namespace");
+    this->Internal->Namespace = create ? PyObject_CallObject(create, NULL) : NULL;
+    if (!this->Internal->Namespace)
+      {
+      PyErr_Print();
+      success = false;
+      }
+    }
+  pqInternal::releaseShell();
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::requestRenders()
+{
+  PyObject* take = pqInternal::dispatcher("_take_renders");
+  PyObject* views = take ? PyObject_CallObject(take, NULL) : NULL;
+  if (!views || !PyList_Check(views))
+    {
+    PyErr_Print();
+    Py_XDECREF(views);
+    return;
+    }
+
+  pqServerManagerModel* model = pqApplicationCore::instance()->getServerManagerModel();
+  for (Py_ssize_t i = 0; i < PyList_Size(views); ++i)
+    {
+    vtkSMProxy* proxy = vtkSMProxy::SafeDownCast(
+      vtkPythonUtil::GetPointerFromObject(PyList_GetItem(views, i), "vtkSMProxy"));
+    pqView* view = proxy ? model->findItem<pqView*>(proxy) : NULL;
+    if (view)
+      {
+      pqSocketRenderThrottle::instance()->requestRender(view, this->Internal->RenderInterval);
+      }
+    else
+      {
+      PyErr_Clear();
+      }
+    }
+  Py_DECREF(views);
 }
 
 //-----------------------------------------------------------------------------
-void pqPythonSocketHandler::onSocketOpened()
+void pqPythonSocketHandler::sendImage(const pqSocketMessageHeader& header)
 {
+  pqView* view = pqActiveObjects::instance().activeView();
+  vtkImageData* image = view ? view->captureImage(1) : NULL;
+  if (!image)
+    {
+    qWarning("Remote control: no image of the active view for request %u.", header.RequestId);
+    return;
+    }
+
+  pqSocketImageEncoder::Codec codec = static_cast<pqSocketImageEncoder::Codec>(
+    (header.Flags & pqSocketMessageHeader::ImageCodecMask) >> pqSocketMessageHeader::ImageCodecShift);
+  if (codec > pqSocketImageEncoder::RawCodec)
+    {
+    codec = pqSocketImageEncoder::PNGCodec;
+    }
+  QByteArray data = this->Internal->ImageEncoder.encode(image, codec,
+    (header.Flags & pqSocketMessageHeader::ImageDeltaFlag) != 0);
+  image->Delete();
+
+  // Images are dropped when the client falls behind, the next delta must
+  // then be relative to the last frame it actually received.
+  if (!this->writeMessage(
+        pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ImageMessage),
+        data.constData(), data.size(), true))
+    {
+    this->Internal->ImageEncoder.reset();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::executeSweep(const pqSocketMessageHeader& header,
+                                         const char* payload, int payloadSize)
+{
+  // Replayed from a journal there is nobody to send the images to.
+  if (!this->socket())
+    {
+    return;
+    }
+
+  pqSocketSweep* sweep = new pqSocketSweep(this, this);
+  QString error;
+  if (!sweep->initialize(payload, payloadSize, error))
+    {
+    delete sweep;
+    this->writeErrorReply(header, error);
+    return;
+    }
+
+  QByteArray reply = QString("{\"result\": %1, \"stdout\": \"\", \"stderr\": \"\", "
+                             "\"exception\": null, \"time\": 0}").arg(sweep->description()).toUtf8();
+  this->writeMessage(pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+
+  this->Internal->Sweep = sweep;
+  this->Internal->SweepHeader = header;
+  this->connect(sweep, SIGNAL(imageReady(int, const QByteArray&)),
+                SLOT(onSweepImage(int, const QByteArray&)));
+  this->connect(sweep, SIGNAL(finished()), SLOT(onSweepFinished()));
+  this->holdMessages(true);
+  sweep->start();
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::onSweepImage(int view, const QByteArray& image)
+{
+  this->writeMessage(pqSocketMessageHeader(this->Internal->SweepHeader.RequestId,
+                       pqSocketMessageHeader::ImageMessage,
+                       static_cast<quint16>(view & pqSocketMessageHeader::DataIndexMask)),
+                     image.constData(), image.size());
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::onSweepFinished()
+{
+  // The images end with one flagged as the end of data that holds the
+  // statistics of the sweep instead of pixels.
+  pqSocketSweep* sweep = this->Internal->Sweep;
+  this->Internal->Sweep = 0;
+  QByteArray statistics = sweep->statistics().toUtf8();
+  quint16 flags = pqSocketMessageHeader::EndOfDataFlag;
+  if (sweep->isCancelled())
+    {
+    flags |= pqSocketMessageHeader::CancelledFlag;
+    }
+  this->writeMessage(pqSocketMessageHeader(this->Internal->SweepHeader.RequestId,
+                                           pqSocketMessageHeader::ImageMessage, flags),
+                     statistics.constData(), statistics.size());
+  sweep->release();
+  this->holdMessages(false);
+}
+
+//-----------------------------------------------------------------------------
+bool pqPythonSocketHandler::cancelStream(quint32 requestId)
+{
+  if (this->Internal->Sweep && this->Internal->SweepHeader.RequestId == requestId)
+    {
+    this->Internal->Sweep->cancel();
+    return true;
+    }
+  return pqSocketHandler::cancelStream(requestId);
 }
 
 //-----------------------------------------------------------------------------
 void pqPythonSocketHandler::onSocketClosed()
 {
+  if (this->Internal->Sweep)
+    {
+    this->Internal->Sweep->cancel();
+    }
+  pqSocketHandler::onSocketClosed();
 }
 
 //-----------------------------------------------------------------------------
-void pqPythonSocketHandler::onSocketReadReady()
+void pqPythonSocketHandler::writeReply(const pqSocketMessageHeader& header,
+                                       PyObject* returnValue)
 {
-  QByteArray bytes = this->socket()->readAll();
+  if (!returnValue)
+    {
+    PyErr_Print();
+    this->writeErrorReply(header, "The remote control handler failed.");
+    return;
+    }
 
-  pqPythonShell* shell = pqPVApplicationCore::instance()->pythonManager()->pythonShellDialog()->shell();
-  shell->makeCurrent();
+  char* replyBuffer;
+  Py_ssize_t replyLength;
+  if (PyString_Check(returnValue)
+      && !PyString_AsStringAndSize(returnValue, &replyBuffer, &replyLength))
+    {
+    this->writeMessage(
+      pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+      replyBuffer, static_cast<int>(replyLength));
+    }
+  Py_DECREF(returnValue);
+}
 
-  PyObject* returnValue = PyObject_CallFunction(this->Internal->Callback,
-    const_cast<char*>("s#"), bytes.data(), bytes.length());
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::writeComputeReply(const pqSocketMessageHeader& header,
+                                              const QByteArray& reply)
+{
+  if (reply.isEmpty())
+    {
+    this->writeErrorReply(header, "The remote control handler failed.");
+    return;
+    }
+  this->writeMessage(
+    pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+    reply.constData(), reply.size());
+}
+
+//-----------------------------------------------------------------------------
+void pqPythonSocketHandler::receiveArray(const pqSocketMessageHeader& header,
+                                         const char* payload, int payloadSize)
+{
+  const uchar* bytes = reinterpret_cast<const uchar*>(payload);
+  int offset = 0;
 
-  if (returnValue && PyString_Check(returnValue))
+  int nameLength = payloadSize >= 2 ? qFromBigEndian<quint16>(bytes) : 0;
+  offset += 2;
+  if (payloadSize < offset + nameLength + 6)
     {
-    char* buffer;
-    Py_ssize_t bufferLength;
-    if (!PyString_AsStringAndSize(returnValue, &buffer, &bufferLength))
+    this->writeErrorReply(header, "Truncated array header.");
+    return;
+    }
+  QByteArray name(payload + offset, nameLength);
+  offset += nameLength;
+
+  int dataType = bytes[offset];
+  int dimensions = bytes[offset + 1];
+  quint32 components = qFromBigEndian<quint32>(bytes + offset + 2);
+  offset += 6;
+  if (payloadSize < offset + 4*dimensions)
+    {
+    this->writeErrorReply(header, "Truncated array shape.");
+    return;
+    }
+
+  int elementSize = 0;
+  switch (dataType)
+    {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:
+    case VTK_UNSIGNED_CHAR:
+      elementSize = 1;
+      break;
+    case VTK_SHORT:
+    case VTK_UNSIGNED_SHORT:
+      elementSize = 2;
+      break;
+    case VTK_INT:
+    case VTK_UNSIGNED_INT:
+    case VTK_FLOAT:
+      elementSize = 4;
+      break;
+    case VTK_LONG_LONG:
+    case VTK_UNSIGNED_LONG_LONG:
+    case VTK_DOUBLE:
+      elementSize = 8;
+      break;
+    case VTK_LONG:
+    case VTK_UNSIGNED_LONG:
+      elementSize = sizeof(long);
+      break;
+    case VTK_ID_TYPE:
+      elementSize = sizeof(vtkIdType);
+      break;
+    }
+  if (!elementSize || !components || components > static_cast<quint32>(VTK_INT_MAX))
+    {
+    this->writeErrorReply(header, QString("Unsupported array type %1 with %2 components.")
+      .arg(dataType).arg(components));
+    return;
+    }
+
+  // Every factor of the size is checked so that a malformed shape cannot
+  // wrap around.  Inline values must fit in a message, shared ones in the
+  // ids of VTK and then in the mapped file.
+  bool shared = header.Type == pqSocketMessageHeader::SharedArrayMessage;
+  qint64 limit = shared ? static_cast<qint64>(VTK_ID_MAX) : this->maximumPayloadSize();
+  QList<quint32> shape;
+  qint64 dataSize = 1;
+  bool valid = multiplyWithin(dataSize, components, limit)
+    && multiplyWithin(dataSize, elementSize, limit);
+  qint64 tupleSize = dataSize;
+  for (int i = 0; i < dimensions; ++i, offset += 4)
+    {
+    shape.append(qFromBigEndian<quint32>(bytes + offset));
+    valid = valid && multiplyWithin(dataSize, shape.last(), limit);
+    }
+  if (!valid)
+    {
+    this->writeErrorReply(header, QString("Array '%1' is larger than %2 bytes.")
+      .arg(name.constData()).arg(limit));
+    return;
+    }
+  qint64 tuples = dataSize / tupleSize;
+
+  vtkDataArray* array = vtkDataArray::CreateDataArray(dataType);
+  array->SetName(name.constData());
+  array->SetNumberOfComponents(static_cast<int>(components));
+
+  if (shared)
+    {
+    // The values stay where the producer wrote them, the array is pointed at
+    // the mapped region of the file named by the message.
+    int pathLength = payloadSize - offset >= 2 ? qFromBigEndian<quint16>(bytes + offset) : -1;
+    offset += 2;
+    if (pathLength < 0 || payloadSize != offset + pathLength + 8)
+      {
+      array->Delete();
+      this->writeErrorReply(header, "Malformed shared array descriptor.");
+      return;
+      }
+    QString path = QString::fromUtf8(payload + offset, pathLength);
+    qint64 fileOffset = static_cast<qint64>(qFromBigEndian<quint64>(bytes + offset + pathLength));
+
+    QString error;
+    if (!pqInternal::SharedArrays->attach(array, path, fileOffset, dataSize, &error))
       {
-      this->socket()->write(buffer, bufferLength);
+      array->Delete();
+      this->writeErrorReply(header, error);
+      return;
       }
-    Py_DECREF(returnValue);
     }
+  else
+    {
+    if (dataSize != payloadSize - offset)
+      {
+      array->Delete();
+      this->writeErrorReply(header, QString("Array '%1' needs %2 bytes of data, received %3.")
+        .arg(name.constData()).arg(dataSize).arg(payloadSize - offset));
+      return;
+      }
+
+    // The values are copied once, from the receive buffer into the array that
+    // python sees, and never go through a text representation.
+    array->SetNumberOfTuples(static_cast<vtkIdType>(tuples));
+    memcpy(array->GetVoidPointer(0), payload + offset, dataSize);
+    }
+
+  pqInternal::acquireShell();
+
+  PyObject* pythonArray = vtkPythonUtil::GetObjectFromPointer(array);
+  array->Delete();
+  PyObject* pythonShape = PyTuple_New(shape.size());
+  for (int i = 0; i < shape.size(); ++i)
+    {
+    PyTuple_SET_ITEM(pythonShape, i, PyLong_FromUnsignedLong(shape[i]));
+    }
+  PyObject* pythonName = PyString_FromStringAndSize(name.constData(), name.size());
+
+  PyObject* receive = pqInternal::dispatcher("_receive_array");
+  PyObject* returnValue = receive ? PyObject_CallFunctionObjArgs(receive,
+    pythonName, pythonArray, pythonShape, NULL) : NULL;
+  Py_DECREF(pythonName);
+  Py_DECREF(pythonShape);
+  Py_DECREF(pythonArray);
+  this->writeReply(header, returnValue);
 
-  shell->releaseControl();
+  pqInternal::releaseShell();
 }
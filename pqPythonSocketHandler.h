@@ -35,6 +35,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pqSocketHandler.h"
 
+class pqPythonCodeCache;
+
+#ifndef PyObject_HEAD
+struct _object;
+typedef _object PyObject;
+#endif
+
 class pqPythonSocketHandler : public pqSocketHandler
 {
   Q_OBJECT
@@ -44,9 +51,73 @@ public:
   pqPythonSocketHandler(QObject* parent);
   virtual ~pqPythonSocketHandler();
 
-  virtual void onSocketOpened();
+  virtual pqSocketHandler* newInstance(QObject* parent);
+
+  virtual void beginBatch();
+  virtual void endBatch();
+
+  // Number of times the python shell was made current and number of scripts
+  // executed, the difference is what batching saved.
+  static quint64 shellAcquisitions();
+  static quint64 executedScripts();
+
+  // Cache of compiled scripts shared by all python socket handlers.
+  static pqPythonCodeCache* codeCache();
+
+  // Number of compiled scripts kept, shrinking the cache drops the least
+  // recently used ones.
+  static void setCodeCacheSize(int scripts);
+
+  // Writes the reply of a script that ran in the compute lane.  An empty
+  // reply means that the dispatcher failed.
+  void writeComputeReply(const pqSocketMessageHeader& header, const QByteArray& reply);
+
+  // Also cancels a running sweep.
+  virtual bool cancelStream(quint32 requestId);
+
   virtual void onSocketClosed();
-  virtual void onSocketReadReady();
+
+protected:
+
+  virtual void executeMessage(const pqSocketMessageHeader& header,
+                              const char* payload, int payloadSize);
+
+  // Adds the namespace setting: 'shared' runs scripts in __main__ like the
+  // python shell, 'isolated' in a namespace of their own and 'reset'
+  // replaces that namespace with a fresh one.  Also adds the render
+  // setting, see pqSocketRenderThrottle.
+  virtual bool configure(const QString& key, const QString& value);
+
+  // Answers FetchMessages with pqSocketFetch.
+  virtual pqSocketOutputStream* createStream(const pqSocketMessageHeader& header,
+                                             const char* payload, int payloadSize,
+                                             QString& result, QString& error);
+
+  // Publishes an ArrayMessage or SharedArrayMessage to python as
+  // remote_arrays[name].
+  void receiveArray(const pqSocketMessageHeader& header,
+                    const char* payload, int payloadSize);
+
+  // Passes the views that the last script rendered with Render() to the
+  // render throttle.
+  void requestRenders();
+
+  // Sends the active view as an ImageMessage answering the request.
+  void sendImage(const pqSocketMessageHeader& header);
+
+  // Answers a SweepMessage with pqSocketSweep.  Its images are written as
+  // they come, the other messages of the connection wait until it is done.
+  void executeSweep(const pqSocketMessageHeader& header,
+                    const char* payload, int payloadSize);
+
+  // Sends the JSON string returned by a python callback as the reply to the
+  // request, steals the reference.
+  void writeReply(const pqSocketMessageHeader& header, PyObject* returnValue);
+
+protected slots:
+
+  void onSweepImage(int view, const QByteArray& image);
+  void onSweepFinished();
 
 private:
   class pqInternal;
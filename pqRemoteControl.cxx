@@ -31,15 +31,60 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 =========================================================================*/
 
 #include "pqRemoteControl.h"
+#include "pqPythonCodeCache.h"
+#include "pqPythonComputeLane.h"
+#include "pqSocketEventSource.h"
+#include "pqSocketIOThread.h"
 #include "pqSocketItem.h"
+#include "pqSocketJournal.h"
+#include "pqSocketJournalReplay.h"
+#include "pqSocketRenderThrottle.h"
+#include "pqSocketScheduler.h"
 #include "pqPythonSocketHandler.h"
+#include "pqProxySocketHandler.h"
 #include "ui_pqRemoteControl.h"
 
+#include <QFile>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QStringList>
+#include <QTableWidget>
+#include <QTextStream>
+#include <QTimer>
+
+namespace
+{
+  QString formatBytes(quint64 bytes)
+    {
+    if (bytes >= 10*1024*1024)
+      {
+      return QString("%1 MB").arg(bytes / (1024*1024));
+      }
+    if (bytes >= 10*1024)
+      {
+      return QString("%1 KB").arg(bytes / 1024);
+      }
+    return QString("%1 B").arg(bytes);
+    }
+
+  QString formatPercentiles(const pqSocketHistogram& histogram)
+    {
+    return QString("%1 / %2 ms")
+      .arg(histogram.percentile(0.5) / 1000.0, 0, 'f', 1)
+      .arg(histogram.percentile(0.99) / 1000.0, 0, 'f', 1);
+    }
+}
 
 class pqRemoteControl::pqInternal : public Ui::pqRemoteControl
 {
 public:
 
+  pqSocketScheduler* Scheduler;
+  pqSocketIOThread* IOThread;
+  QTimer StatisticsTimer;
+  pqSocketJournal Journal;
+  pqSocketJournalReplay* Replay;
+  QString ReplayFileName;
 };
 
 pqRemoteControl::pqRemoteControl(QWidget* parent, Qt::WindowFlags flags) : QDockWidget(parent, flags)
@@ -50,16 +95,312 @@ pqRemoteControl::pqRemoteControl(QWidget* parent, Qt::WindowFlags flags) : QDock
   this->setWidget(widget);
   this->setWindowTitle("Remote Control");
   this->connect(this->Internal->NewButton, SIGNAL(clicked()), SLOT(onNewClicked()));
+  this->connect(this->Internal->SaveStatisticsButton, SIGNAL(clicked()),
+                SLOT(onSaveStatisticsClicked()));
+  this->connect(this->Internal->RecordJournalButton, SIGNAL(toggled(bool)),
+                SLOT(onRecordJournalToggled(bool)));
+  this->connect(this->Internal->ReplayJournalButton, SIGNAL(clicked()),
+                SLOT(onReplayJournalClicked()));
+  this->connect(this->Internal->IOThreadCheck, SIGNAL(toggled(bool)),
+                SLOT(onIOThreadToggled(bool)));
+  this->Internal->IOThread = 0;
+
+  this->Internal->Replay = new pqSocketJournalReplay(this);
+  this->Internal->Replay->addPrototype(new pqPythonSocketHandler(this));
+  this->Internal->Replay->addPrototype(new pqProxySocketHandler(this));
+  this->connect(this->Internal->Replay, SIGNAL(finished()), SLOT(onReplayFinished()));
+
+  this->Internal->Scheduler = new pqSocketScheduler(this);
+  new pqSocketEventSource(this);
+
+  this->Internal->TimeBudgetSpin->setValue(this->Internal->Scheduler->timeBudget());
+  this->Internal->QueueDepthSpin->setValue(this->Internal->Scheduler->maximumQueueDepth());
+  this->Internal->BackpressureCombo->setCurrentIndex(
+    this->Internal->Scheduler->backpressurePolicy() == pqSocketScheduler::RejectMessages ? 1 : 0);
+  this->Internal->BatchingCheck->setChecked(this->Internal->Scheduler->batchingEnabled());
+  this->Internal->BatchSizeSpin->setValue(this->Internal->Scheduler->maximumBatchSize());
+  this->connect(this->Internal->TimeBudgetSpin, SIGNAL(valueChanged(int)),
+                SLOT(onSchedulerSettingsChanged()));
+  this->connect(this->Internal->QueueDepthSpin, SIGNAL(valueChanged(int)),
+                SLOT(onSchedulerSettingsChanged()));
+  this->connect(this->Internal->BackpressureCombo, SIGNAL(currentIndexChanged(int)),
+                SLOT(onSchedulerSettingsChanged()));
+  this->connect(this->Internal->BatchingCheck, SIGNAL(toggled(bool)),
+                SLOT(onSchedulerSettingsChanged()));
+  this->connect(this->Internal->BatchSizeSpin, SIGNAL(valueChanged(int)),
+                SLOT(onSchedulerSettingsChanged()));
+
+  pqPythonCodeCache* codeCache = pqPythonSocketHandler::codeCache();
+  this->Internal->CodeCacheSpin->setValue(codeCache ? codeCache->maximumEntries() : 0);
+  this->connect(this->Internal->CodeCacheSpin, SIGNAL(valueChanged(int)),
+                SLOT(onCodeCacheSizeChanged(int)));
+
+  // The scheduler reports after every event loop turn, the label is only
+  // refreshed a few times per second.
+  this->Internal->StatisticsTimer.setSingleShot(true);
+  this->Internal->StatisticsTimer.setInterval(250);
+  this->connect(this->Internal->Scheduler, SIGNAL(statisticsChanged()),
+                SLOT(onStatisticsChanged()));
+  this->connect(&this->Internal->StatisticsTimer, SIGNAL(timeout()),
+                SLOT(updateStatistics()));
 }
 
 pqRemoteControl::~pqRemoteControl()
 {
+  if (pqSocketHandler::journal() == &this->Internal->Journal)
+    {
+    pqSocketHandler::setJournal(0);
+    }
+
+  // The sockets of the connections are deleted in the network thread, which
+  // has to outlive them.
+  qDeleteAll(this->findChildren<pqSocketItem*>());
+  delete this->Internal->IOThread;
   delete this->Internal;
 }
 
 void pqRemoteControl::onNewClicked()
 {
   pqSocketItem* socketItem = new pqSocketItem(this);
-  socketItem->setHandler(new pqPythonSocketHandler(socketItem));
+  socketItem->addHandler("python", new pqPythonSocketHandler(socketItem));
+  socketItem->addHandler("proxy", new pqProxySocketHandler(socketItem));
+  socketItem->setScheduler(this->Internal->Scheduler);
+  socketItem->setIOThread(
+    this->Internal->IOThreadCheck->isChecked() ? this->Internal->IOThread : 0);
   socketItem->addWidgetsToLayout(this->Internal->GridLayout);
 }
+
+void pqRemoteControl::onIOThreadToggled(bool enabled)
+{
+  if (enabled && !this->Internal->IOThread)
+    {
+    this->Internal->IOThread = new pqSocketIOThread(0);
+    }
+
+  // Open connections keep the thread they started with.
+  foreach (pqSocketItem* socketItem, this->findChildren<pqSocketItem*>())
+    {
+    socketItem->setIOThread(enabled ? this->Internal->IOThread : 0);
+    }
+}
+
+void pqRemoteControl::onSchedulerSettingsChanged()
+{
+  pqSocketScheduler* scheduler = this->Internal->Scheduler;
+  scheduler->setTimeBudget(this->Internal->TimeBudgetSpin->value());
+  scheduler->setMaximumQueueDepth(this->Internal->QueueDepthSpin->value());
+  scheduler->setBackpressurePolicy(this->Internal->BackpressureCombo->currentIndex() == 1
+    ? pqSocketScheduler::RejectMessages : pqSocketScheduler::PauseReading);
+  scheduler->setBatchingEnabled(this->Internal->BatchingCheck->isChecked());
+  scheduler->setMaximumBatchSize(this->Internal->BatchSizeSpin->value());
+  this->Internal->BatchSizeSpin->setEnabled(this->Internal->BatchingCheck->isChecked());
+}
+
+void pqRemoteControl::onCodeCacheSizeChanged(int scripts)
+{
+  pqPythonSocketHandler::setCodeCacheSize(scripts);
+}
+
+void pqRemoteControl::onStatisticsChanged()
+{
+  if (!this->Internal->StatisticsTimer.isActive())
+    {
+    this->Internal->StatisticsTimer.start();
+    }
+}
+
+void pqRemoteControl::updateStatistics()
+{
+  pqSocketScheduler* scheduler = this->Internal->Scheduler;
+  QList<pqSocketStatistics*> connections = pqSocketStatistics::openConnections();
+
+  // The compression of the open connections, summed.
+  pqSocketStatistics total;
+  foreach (const pqSocketStatistics* statistics, connections)
+    {
+    total.CompressedBytesIn += statistics->CompressedBytesIn;
+    total.UncompressedBytesIn += statistics->UncompressedBytesIn;
+    total.CompressedBytesOut += statistics->CompressedBytesOut;
+    total.UncompressedBytesOut += statistics->UncompressedBytesOut;
+    total.CompressionTime += statistics->CompressionTime;
+    }
+  QString compression = QString("\nCompression: in %1:1, out %2:1, %3 ms")
+    .arg(total.CompressedBytesIn
+         ? double(total.UncompressedBytesIn) / total.CompressedBytesIn : 1.0, 0, 'f', 2)
+    .arg(total.CompressedBytesOut
+         ? double(total.UncompressedBytesOut) / total.CompressedBytesOut : 1.0, 0, 'f', 2)
+    .arg(total.CompressionTime / 1000.0, 0, 'f', 1);
+  pqSocketRenderThrottle* throttle = pqSocketRenderThrottle::instance();
+  QString renders = QString("\nRenders: %1 requested, %2 done")
+    .arg(throttle->requestedRenders()).arg(throttle->renders());
+  pqPythonComputeLane* lane = pqPythonComputeLane::instance();
+  QString compute = QString("\nCompute: %1 pending, %2 done")
+    .arg(lane->pendingJobs()).arg(lane->completedJobs());
+  QString codeCache;
+  if (pqPythonCodeCache* cache = pqPythonSocketHandler::codeCache())
+    {
+    codeCache = QString("\nCode cache: %1 of %2 scripts, %3 hits, %4 misses")
+      .arg(cache->entries()).arg(cache->maximumEntries())
+      .arg(cache->hits()).arg(cache->misses());
+    }
+
+  this->Internal->QueueLabel->setText(
+    QString("Queue: %1 waiting (max %2), %3 executed, %4 rejected\n"
+            "Wait: %5 ms avg, %6 ms max    Execute: %7 ms avg, %8 ms max\n"
+            "Python shell switched %9 times for %10 scripts in %11 batches")
+      .arg(scheduler->queueDepth())
+      .arg(scheduler->maximumObservedQueueDepth())
+      .arg(scheduler->executedMessages())
+      .arg(scheduler->rejectedMessages())
+      .arg(scheduler->averageWaitTime(), 0, 'f', 1)
+      .arg(scheduler->maximumWaitTime(), 0, 'f', 1)
+      .arg(scheduler->averageExecutionTime(), 0, 'f', 1)
+      .arg(scheduler->maximumExecutionTime(), 0, 'f', 1)
+      .arg(pqPythonSocketHandler::shellAcquisitions())
+      .arg(pqPythonSocketHandler::executedScripts())
+      .arg(scheduler->batches())
+    + compression + renders + compute + codeCache);
+
+  QTableWidget* table = this->Internal->ConnectionTable;
+  table->setRowCount(connections.size());
+  for (int row = 0; row < connections.size(); ++row)
+    {
+    const pqSocketStatistics* statistics = connections[row];
+    QStringList cells;
+    cells << statistics->name()
+          << QString::number(statistics->MessagesReceived)
+          << formatBytes(statistics->BytesReceived)
+          << formatBytes(statistics->BytesSent)
+          << formatPercentiles(statistics->QueueWait)
+          << formatPercentiles(statistics->Execute)
+          << QString("%1 ms").arg(statistics->Compile.average() / 1000.0, 0, 'f', 2)
+          << formatBytes(static_cast<quint64>(statistics->ReplySize.average()))
+          << QString("%1 / %2, %3 stalls, %4 dropped")
+               .arg(formatBytes(statistics->OutputBuffered),
+                    formatBytes(statistics->MaximumOutputBuffered))
+               .arg(statistics->OutputStalls).arg(statistics->FramesDropped)
+          << QString("%1 sent, %2 merged")
+               .arg(statistics->EventsSent).arg(statistics->EventsCoalesced)
+          << statistics->SlowestMessage;
+    for (int column = 0; column < cells.size(); ++column)
+      {
+      QTableWidgetItem* item = table->item(row, column);
+      if (!item)
+        {
+        item = new QTableWidgetItem;
+        table->setItem(row, column, item);
+        }
+      item->setText(cells[column]);
+      }
+    }
+}
+
+void pqRemoteControl::onSaveStatisticsClicked()
+{
+  QString fileName = QFileDialog::getSaveFileName(this, "Save Remote Control Statistics",
+    QString(), "CSV files (*.csv);;JSON files (*.json)");
+  if (fileName.isEmpty())
+    {
+    return;
+    }
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+    QMessageBox::critical(this, "Save failed",
+      QString("Cannot write %1: %2").arg(fileName).arg(file.errorString()));
+    return;
+    }
+
+  QTextStream stream(&file);
+  QList<pqSocketStatistics*> connections = pqSocketStatistics::openConnections();
+  if (fileName.endsWith(".json", Qt::CaseInsensitive))
+    {
+    QStringList objects;
+    foreach (pqSocketStatistics* statistics, connections)
+      {
+      objects.append(statistics->toJSON());
+      }
+    stream << "[" << objects.join(",\n") << "]\n";
+    }
+  else
+    {
+    stream << pqSocketStatistics::csvHeader() << "\n";
+    foreach (pqSocketStatistics* statistics, connections)
+      {
+      stream << statistics->toCSV() << "\n";
+      }
+    }
+}
+
+void pqRemoteControl::onRecordJournalToggled(bool record)
+{
+  if (!record)
+    {
+    pqSocketHandler::setJournal(0);
+    this->Internal->Journal.close();
+    this->Internal->RecordJournalButton->setText("Record Journal...");
+    return;
+    }
+
+  QString fileName = QFileDialog::getSaveFileName(this, "Record Remote Control Journal",
+    QString(), "Journal files (*.pvrcj)");
+  QString error;
+  if (fileName.isEmpty() || !this->Internal->Journal.open(fileName, &error))
+    {
+    if (!fileName.isEmpty())
+      {
+      QMessageBox::critical(this, "Recording failed",
+        QString("Cannot write %1: %2").arg(fileName, error));
+      }
+    this->Internal->RecordJournalButton->setChecked(false);
+    return;
+    }
+  pqSocketHandler::setJournal(&this->Internal->Journal);
+  this->Internal->RecordJournalButton->setText("Stop Recording");
+}
+
+void pqRemoteControl::onReplayJournalClicked()
+{
+  if (this->Internal->Replay->isRunning())
+    {
+    this->Internal->Replay->stop();
+    return;
+    }
+
+  QString fileName = QFileDialog::getOpenFileName(this, "Replay Remote Control Journal",
+    QString(), "Journal files (*.pvrcj);;All files (*)");
+  if (fileName.isEmpty())
+    {
+    return;
+    }
+  QString error;
+  if (!this->Internal->Replay->start(fileName, this->Internal->OriginalPacingCheck->isChecked(),
+                                     &error))
+    {
+    QMessageBox::critical(this, "Replay failed", error);
+    return;
+    }
+  this->Internal->ReplayFileName = fileName;
+  this->Internal->ReplayJournalButton->setText("Stop Replay");
+}
+
+void pqRemoteControl::onReplayFinished()
+{
+  this->Internal->ReplayJournalButton->setText("Replay Journal...");
+
+  // The timing of every message goes next to the journal, the summary is
+  // shown.
+  QString fileName = this->Internal->ReplayFileName + ".replay.csv";
+  QString error;
+  QString report = this->Internal->Replay->report();
+  if (this->Internal->Replay->writeCSV(fileName, &error))
+    {
+    report += QString("\n\nThe timing of every message was written to %1.").arg(fileName);
+    }
+  else
+    {
+    report += QString("\n\nCannot write %1: %2").arg(fileName, error);
+    }
+  QMessageBox::information(this, "Replay finished", report);
+}
@@ -45,6 +45,15 @@ public:
 protected slots:
 
   void onNewClicked();
+  void onStatisticsChanged();
+  void updateStatistics();
+  void onSaveStatisticsClicked();
+  void onRecordJournalToggled(bool record);
+  void onReplayJournalClicked();
+  void onReplayFinished();
+  void onIOThreadToggled(bool enabled);
+  void onSchedulerSettingsChanged();
+  void onCodeCacheSizeChanged(int scripts);
 
 private:
 
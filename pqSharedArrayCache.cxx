@@ -0,0 +1,147 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSharedArrayCache.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSharedArrayCache.h"
+
+#include <vtkDataArray.h>
+
+#include <QFile>
+#include <QSet>
+
+//-----------------------------------------------------------------------------
+pqSharedArrayCache::pqSharedArrayCache()
+{
+}
+
+//-----------------------------------------------------------------------------
+pqSharedArrayCache::~pqSharedArrayCache()
+{
+  this->releaseUnused();
+
+  // Arrays still referenced from python keep pointing into their mapping, so
+  // those files are deliberately left open, closing them would unmap the
+  // memory under the arrays.
+  for (int i = 0; i < this->Regions.size(); ++i)
+    {
+    this->Regions[i].Array->Delete();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSharedArrayCache::attach(vtkDataArray* array, const QString& path,
+                                qint64 offset, qint64 length, QString* error)
+{
+  this->releaseUnused();
+
+  QFile* file = this->Files.value(path);
+  if (!file)
+    {
+    file = new QFile(path);
+    if (!file->open(QIODevice::ReadOnly))
+      {
+      *error = QString("Cannot open the shared file %1: %2").arg(path).arg(file->errorString());
+      delete file;
+      return false;
+      }
+    this->Files.insert(path, file);
+    }
+
+  if (offset < 0 || length <= 0 || offset > file->size() || length > file->size() - offset)
+    {
+    *error = QString("The region of %1 bytes at offset %2 is outside of %3.")
+      .arg(length).arg(offset).arg(path);
+    this->releaseUnused();
+    return false;
+    }
+
+  uchar* data = file->map(offset, length);
+  if (!data)
+    {
+    *error = QString("Cannot map %1: %2").arg(path).arg(file->errorString());
+    this->releaseUnused();
+    return false;
+    }
+
+  // Save is set so that the array never frees the mapped memory, the cache
+  // unmaps it once the array is only referenced from here.
+  array->SetVoidArray(data, length / array->GetDataTypeSize(), 1);
+  array->Register(NULL);
+
+  pqRegion region;
+  region.File = file;
+  region.Data = data;
+  region.Size = length;
+  region.Array = array;
+  this->Regions.append(region);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSharedArrayCache::releaseUnused()
+{
+  QSet<QFile*> used;
+  for (int i = this->Regions.size() - 1; i >= 0; --i)
+    {
+    pqRegion& region = this->Regions[i];
+    if (region.Array->GetReferenceCount() > 1)
+      {
+      used.insert(region.File);
+      continue;
+      }
+    region.Array->Delete();
+    region.File->unmap(region.Data);
+    this->Regions.removeAt(i);
+    }
+
+  QMap<QString, QFile*>::iterator iter = this->Files.begin();
+  while (iter != this->Files.end())
+    {
+    if (used.contains(iter.value()))
+      {
+      ++iter;
+      continue;
+      }
+    delete iter.value();
+    iter = this->Files.erase(iter);
+    }
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSharedArrayCache::mappedBytes() const
+{
+  qint64 bytes = 0;
+  for (int i = 0; i < this->Regions.size(); ++i)
+    {
+    bytes += this->Regions[i].Size;
+    }
+  return bytes;
+}
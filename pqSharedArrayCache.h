@@ -0,0 +1,85 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSharedArrayCache.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSharedArrayCache_h
+#define _pqSharedArrayCache_h
+
+#include <QList>
+#include <QMap>
+#include <QString>
+
+class QFile;
+class vtkDataArray;
+
+// Maps regions of files, typically in a RAM backed file system such as
+// /dev/shm, as the values of vtkDataArrays so that a producer on the same
+// host can hand over large arrays without sending them through a socket.
+//
+// Regions are mapped read-only: the arrays show the producer's values and
+// nothing is written back, modifying their values is a segmentation fault.
+// A region stays mapped as long as its array is referenced outside of the
+// cache.  Files are kept open while any of their regions is mapped, so a
+// producer alternating between a few buffers does not reopen them.
+class pqSharedArrayCache
+{
+public:
+
+  pqSharedArrayCache();
+  ~pqSharedArrayCache();
+
+  // Points the array at length bytes of the file starting at offset.  The
+  // number of components must already be set.  Returns false and sets error
+  // if the region cannot be mapped.
+  bool attach(vtkDataArray* array, const QString& path, qint64 offset, qint64 length,
+              QString* error);
+
+  // Unmaps the regions whose arrays are no longer used and closes the files
+  // that have no mapped region left.
+  void releaseUnused();
+
+  int mappedRegions() const {return this->Regions.size();}
+  qint64 mappedBytes() const;
+
+private:
+
+  struct pqRegion
+    {
+    QFile* File;
+    uchar* Data;
+    qint64 Size;
+    vtkDataArray* Array;
+    };
+
+  QMap<QString, QFile*> Files;
+  QList<pqRegion> Regions;
+};
+
+#endif
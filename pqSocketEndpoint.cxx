@@ -0,0 +1,774 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketEndpoint.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketEndpoint.h"
+#include "pqSocketHandler.h"
+#include "pqSocketIOThread.h"
+#include "pqSocketScheduler.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <stdlib.h>
+
+namespace
+{
+  void abortSocket(QIODevice* device)
+    {
+    if (QTcpSocket* socket = qobject_cast<QTcpSocket*>(device))
+      {
+      socket->abort();
+      }
+    else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(device))
+      {
+      socket->abort();
+      }
+    else if (pqSocketIOChannel* channel = qobject_cast<pqSocketIOChannel*>(device))
+      {
+      channel->abort();
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+class pqSocketEndpoint::pqInternal
+{
+public:
+
+  pqInternal()
+    {
+    this->Type = ServerSocket;
+    this->Protocol = pqSocketHandler::RawProtocol;
+    this->Prototype = 0;
+    this->MaximumClients = 1;
+    this->Retry = false;
+    this->Started = false;
+    this->TcpServer = 0;
+    this->LocalServer = 0;
+    this->PendingSocket = 0;
+    this->PendingHandler = 0;
+    this->Port = 0;
+    this->ReconnectAttempt = 0;
+    this->LocalConnections = 0;
+    }
+
+  struct pqConnection
+    {
+    QIODevice* Socket;
+    pqSocketHandler* Handler;
+    };
+
+  int indexOf(QObject* socket) const
+    {
+    for (int i = 0; i < this->Connections.size(); ++i)
+      {
+      if (this->Connections[i].Socket == socket)
+        {
+        return i;
+        }
+      }
+    return -1;
+    }
+
+  QString endpoint() const
+    {
+    if (this->Type == LocalClientSocket || this->Type == LocalServerSocket)
+      {
+      return QString("local socket %1").arg(this->ServerName);
+      }
+    return QString("%1 on port %2").arg(this->Host).arg(this->Port);
+    }
+
+  SocketType Type;
+  pqSocketHandler::ProtocolType Protocol;
+  pqSocketHandler* Prototype;
+  QString HostString;
+  QString PortString;
+  int MaximumClients;
+  bool Retry;
+  bool Started;
+  QString ErrorString;
+  QString Status;
+  QString Detail;
+
+  QTcpServer* TcpServer;
+  QLocalServer* LocalServer;
+  QIODevice* PendingSocket;
+  pqSocketHandler* PendingHandler;
+  QList<pqConnection> Connections;
+  QString Host;
+  int Port;
+  QString ServerName;
+  QTimer ReconnectTimer;
+  int ReconnectAttempt;
+  int LocalConnections;
+
+  QPointer<pqSocketScheduler> Scheduler;
+  QPointer<pqSocketIOThread> IOThread;
+};
+
+//-----------------------------------------------------------------------------
+pqSocketEndpoint::pqSocketEndpoint(QObject* parent) : QObject(parent)
+{
+  this->Internal = new pqInternal;
+  this->Internal->ReconnectTimer.setSingleShot(true);
+  this->connect(&this->Internal->ReconnectTimer, SIGNAL(timeout()), SLOT(startConnecting()));
+
+  // Seeds the jitter of the reconnect delays, so that clients restarted
+  // together do not retry in lockstep.
+  static bool seeded = false;
+  if (!seeded)
+    {
+    qsrand(QDateTime::currentDateTime().toTime_t()
+           ^ static_cast<uint>(reinterpret_cast<quintptr>(this)));
+    seeded = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketEndpoint::~pqSocketEndpoint()
+{
+  this->stop();
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setSocketType(SocketType type)
+{
+  this->Internal->Type = type;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketEndpoint::SocketType pqSocketEndpoint::socketType() const
+{
+  return this->Internal->Type;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setProtocol(pqSocketHandler::ProtocolType protocol)
+{
+  this->Internal->Protocol = protocol;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setHandler(pqSocketHandler* prototype)
+{
+  this->Internal->Prototype = prototype;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setAddress(const QString& host, const QString& port)
+{
+  this->Internal->HostString = host;
+  this->Internal->PortString = port;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setMaximumClients(int clients)
+{
+  this->Internal->MaximumClients = clients;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setRetry(bool retry)
+{
+  this->Internal->Retry = retry;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setScheduler(pqSocketScheduler* scheduler)
+{
+  this->Internal->Scheduler = scheduler;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setIOThread(pqSocketIOThread* thread)
+{
+  this->Internal->IOThread = thread;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::isClient() const
+{
+  return this->Internal->Type == ClientSocket || this->Internal->Type == LocalClientSocket;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::isLocal() const
+{
+  return this->Internal->Type == LocalClientSocket || this->Internal->Type == LocalServerSocket;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketEndpoint::connectionCount() const
+{
+  return this->Internal->Connections.size();
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketEndpoint::status() const
+{
+  return this->Internal->Status;
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketEndpoint::detail() const
+{
+  return this->Internal->Detail;
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketEndpoint::errorString() const
+{
+  return this->Internal->ErrorString;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::isStarted() const
+{
+  return this->Internal->Started;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::start()
+{
+  if (this->Internal->Started)
+    {
+    return true;
+    }
+  if (!this->Internal->Prototype)
+    {
+    this->Internal->ErrorString = "No handler was chosen.";
+    return false;
+    }
+
+  // Set first, a client reports that it is connecting right away.
+  this->Internal->ErrorString.clear();
+  this->Internal->Started = true;
+  bool success = this->isClient() ? this->connectToHost() : this->openListeningSocket();
+  this->Internal->Started = success;
+  if (success && !this->isClient())
+    {
+    this->Internal->Detail.clear();
+    this->updateStatus();
+    }
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::stop()
+{
+  if (!this->Internal->Started)
+    {
+    return;
+    }
+  this->Internal->Started = false;
+
+  this->stopConnecting();
+  this->closeConnections();
+  if (this->Internal->TcpServer)
+    {
+    this->Internal->TcpServer->close();
+    this->Internal->TcpServer->deleteLater();
+    this->Internal->TcpServer = 0;
+    }
+  if (this->Internal->LocalServer)
+    {
+    this->Internal->LocalServer->close();
+    this->Internal->LocalServer->deleteLater();
+    this->Internal->LocalServer = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::openListeningSocket()
+{
+  if (this->isLocal())
+    {
+    QString name = this->Internal->PortString;
+    if (name.isEmpty())
+      {
+      this->Internal->ErrorString = "The local socket name is empty.";
+      return false;
+      }
+
+    // A server that crashed leaves its socket file behind, which would make
+    // listen() fail.
+    QLocalServer::removeServer(name);
+    this->Internal->ServerName = name;
+    if (this->Internal->IOThread)
+      {
+      this->Internal->LocalServer = new pqSocketIOLocalServer(this);
+      this->connect(this->Internal->LocalServer, SIGNAL(newDescriptor(quintptr)),
+                    SLOT(onNewDescriptor(quintptr)));
+      }
+    else
+      {
+      this->Internal->LocalServer = new QLocalServer(this);
+      this->connect(this->Internal->LocalServer, SIGNAL(newConnection()),
+                    SLOT(onNewConnection()));
+      }
+    if (!this->Internal->LocalServer->listen(name))
+      {
+      this->Internal->ErrorString = QString("Failed to open the local socket %1: %2").arg(name)
+        .arg(this->Internal->LocalServer->errorString());
+      delete this->Internal->LocalServer;
+      this->Internal->LocalServer = 0;
+      return false;
+      }
+    return true;
+    }
+
+  QString portString = this->Internal->PortString;
+
+  bool portOk;
+  int port = portString.toInt(&portOk);
+  if (!portOk)
+    {
+    this->Internal->ErrorString =
+      QString("The string '%1' is not a valid port number.").arg(portString);
+    return false;
+    }
+
+  if (this->Internal->IOThread)
+    {
+    this->Internal->TcpServer = new pqSocketIOTcpServer(this);
+    this->connect(this->Internal->TcpServer, SIGNAL(newDescriptor(quintptr)),
+                  SLOT(onNewDescriptor(quintptr)));
+    }
+  else
+    {
+    this->Internal->TcpServer = new QTcpServer(this);
+    this->connect(this->Internal->TcpServer, SIGNAL(newConnection()), SLOT(onNewConnection()));
+    }
+
+  bool success = this->Internal->TcpServer->listen(QHostAddress::Any, port);
+  if (!success)
+    {
+    this->Internal->ErrorString = QString("Failed to open a listening socket on port %1: %2")
+      .arg(port).arg(this->Internal->TcpServer->errorString());
+    delete this->Internal->TcpServer;
+    this->Internal->TcpServer = 0;
+    }
+
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketEndpoint::connectToHost()
+{
+  this->Internal->ReconnectAttempt = 0;
+  if (this->isLocal())
+    {
+    this->Internal->ServerName = this->Internal->PortString;
+    if (this->Internal->ServerName.isEmpty())
+      {
+      this->Internal->ErrorString = "The local socket name is empty.";
+      return false;
+      }
+    this->startConnecting();
+    return true;
+    }
+
+  QString portString = this->Internal->PortString;
+
+  bool portOk;
+  int port = portString.toInt(&portOk);
+  if (!portOk)
+    {
+    this->Internal->ErrorString =
+      QString("The string '%1' is not a valid port number.").arg(portString);
+    return false;
+    }
+
+  QString hostString = this->Internal->HostString;
+  if (hostString.isEmpty())
+    {
+    this->Internal->ErrorString = "The host string is empty.";
+    return false;
+    }
+
+  this->Internal->Host = hostString;
+  this->Internal->Port = port;
+  this->startConnecting();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::startConnecting()
+{
+  // The connection is driven by the event loop, the outcome arrives through
+  // onConnected() or onConnectError().
+  this->setStatus("Connecting", QString("Connecting to %1.").arg(this->Internal->endpoint()));
+
+  // With a network thread the socket is created and connected there, the
+  // handler is needed first for the framing.
+  if (this->Internal->IOThread)
+    {
+    this->Internal->PendingHandler = this->newHandler();
+    pqSocketIOChannel* channel = this->newChannel(this->Internal->PendingHandler);
+    this->Internal->PendingSocket = channel;
+    this->connect(channel, SIGNAL(connected()), SLOT(onConnected()));
+    this->connect(channel, SIGNAL(error()), SLOT(onConnectError()));
+    if (this->isLocal())
+      {
+      channel->connectToServer(this->Internal->ServerName);
+      }
+    else
+      {
+      channel->connectToHost(this->Internal->Host, this->Internal->Port);
+      }
+    }
+  else if (this->isLocal())
+    {
+    QLocalSocket* socket = new QLocalSocket(this);
+    this->Internal->PendingSocket = socket;
+    this->connect(socket, SIGNAL(connected()), SLOT(onConnected()));
+    this->connect(socket, SIGNAL(error(QLocalSocket::LocalSocketError)), SLOT(onConnectError()));
+    socket->connectToServer(this->Internal->ServerName);
+    }
+  else
+    {
+    QTcpSocket* socket = new QTcpSocket(this);
+    this->Internal->PendingSocket = socket;
+    this->connect(socket, SIGNAL(connected()), SLOT(onConnected()));
+    this->connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), SLOT(onConnectError()));
+    socket->connectToHost(this->Internal->Host, this->Internal->Port);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::stopConnecting()
+{
+  this->Internal->ReconnectTimer.stop();
+  if (this->Internal->PendingSocket)
+    {
+    this->disconnect(this->Internal->PendingSocket, 0, this, 0);
+    abortSocket(this->Internal->PendingSocket);
+    this->Internal->PendingSocket->deleteLater();
+    this->Internal->PendingSocket = 0;
+    }
+  delete this->Internal->PendingHandler;
+  this->Internal->PendingHandler = 0;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onConnected()
+{
+  QIODevice* socket = this->Internal->PendingSocket;
+  pqSocketHandler* handler = this->Internal->PendingHandler;
+  this->disconnect(socket, 0, this, 0);
+  this->Internal->PendingSocket = 0;
+  this->Internal->PendingHandler = 0;
+  this->Internal->ReconnectAttempt = 0;
+
+  this->addConnection(handler ? handler : this->newHandler(), socket);
+  this->setStatus("Connected", QString("Connected to %1.").arg(this->Internal->endpoint()));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onConnectError()
+{
+  QString reason = QString("Failed to connect to %1: %2")
+    .arg(this->Internal->endpoint()).arg(this->Internal->PendingSocket->errorString());
+  this->stopConnecting();
+  this->connectionLost(reason);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::connectionLost(const QString& reason)
+{
+  if (!this->Internal->Retry)
+    {
+    this->stop();
+    this->setStatus(QString(), reason);
+    emit this->stopped(reason);
+    return;
+    }
+
+  // Exponential backoff from half a second up to 30 seconds, spread by
+  // +/-25% of jitter.
+  int delay = 500 << qMin(this->Internal->ReconnectAttempt, 6);
+  delay = qMin(delay, 30000);
+  delay = static_cast<int>(delay * (0.75 + 0.5 * qrand() / RAND_MAX));
+  this->Internal->ReconnectAttempt++;
+  this->Internal->ReconnectTimer.start(delay);
+
+  this->setStatus(QString("Retry in %1 s").arg(delay / 1000.0, 0, 'f', 1), reason);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::setStatus(const QString& status, const QString& detail)
+{
+  this->Internal->Status = status;
+  this->Internal->Detail = detail;
+  emit this->statusChanged();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::updateStatus()
+{
+  int count = this->Internal->Connections.size();
+  QString status;
+  if (this->isClient() || count == 1)
+    {
+    status = "Connected";
+    }
+  else if (count == 0)
+    {
+    status = "Waiting";
+    }
+  else
+    {
+    status = QString("%1 clients").arg(count);
+    }
+  this->setStatus(status, this->Internal->Detail);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onNewConnection()
+{
+  forever
+    {
+    QIODevice* socket = 0;
+    QString peer;
+    if (this->Internal->TcpServer)
+      {
+      QTcpSocket* tcpSocket = this->Internal->TcpServer->nextPendingConnection();
+      socket = tcpSocket;
+      peer = tcpSocket ? tcpSocket->peerAddress().toString() : QString();
+      }
+    else if (this->Internal->LocalServer)
+      {
+      socket = this->Internal->LocalServer->nextPendingConnection();
+      peer = this->Internal->LocalServer->serverName();
+      }
+    if (!socket)
+      {
+      break;
+      }
+
+    if (this->Internal->Connections.size() >= this->Internal->MaximumClients)
+      {
+      qWarning() << "Remote control: refusing connection from" << peer
+                 << ", the limit of" << this->Internal->MaximumClients
+                 << "clients is reached.";
+      socket->close();
+      socket->deleteLater();
+      continue;
+      }
+
+    this->addConnection(this->newHandler(), socket);
+    }
+  this->updateStatus();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onNewDescriptor(quintptr descriptor)
+{
+  // Refused connections are closed right here, they never reach the network
+  // thread.
+  if (this->Internal->Connections.size() >= this->Internal->MaximumClients)
+    {
+    QString peer;
+    if (this->isLocal())
+      {
+      QLocalSocket socket;
+      socket.setSocketDescriptor(descriptor);
+      socket.abort();
+      peer = this->Internal->ServerName;
+      }
+    else
+      {
+      QTcpSocket socket;
+      socket.setSocketDescriptor(static_cast<int>(descriptor));
+      peer = socket.peerAddress().toString();
+      socket.abort();
+      }
+    qWarning() << "Remote control: refusing connection from" << peer
+               << ", the limit of" << this->Internal->MaximumClients
+               << "clients is reached.";
+    return;
+    }
+
+  pqSocketHandler* handler = this->newHandler();
+  pqSocketIOChannel* channel = this->newChannel(handler);
+  channel->openDescriptor(descriptor, this->isLocal());
+  this->addConnection(handler, channel);
+  this->updateStatus();
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHandler* pqSocketEndpoint::newHandler()
+{
+  pqSocketHandler* handler = this->Internal->Prototype->newInstance(this);
+  handler->setProtocol(this->Internal->Protocol);
+  return handler;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOChannel* pqSocketEndpoint::newChannel(pqSocketHandler* handler)
+{
+  // The network thread holds back as many bytes as the handler lets pile up
+  // in its output, a message of the maximum payload size still passes alone.
+  pqSocketIOChannel* channel = this->Internal->IOThread->newChannel(
+    handler->headerSize(), handler->maximumPayloadSize(), handler->outputHighWaterMark(),
+    handler->connectionId());
+  channel->setParent(this);
+  return channel;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::addConnection(pqSocketHandler* handler, QIODevice* socket)
+{
+  pqInternal::pqConnection connection;
+  connection.Handler = handler;
+  pqSocketIOChannel* channel = qobject_cast<pqSocketIOChannel*>(socket);
+  if (QTcpSocket* tcpSocket = qobject_cast<QTcpSocket*>(socket))
+    {
+    connection.Handler->statistics().setName(QString("%1:%2")
+      .arg(tcpSocket->peerAddress().toString()).arg(tcpSocket->peerPort()));
+    }
+  else if (channel && !this->isLocal())
+    {
+    // The peer of an accepted connection is known once the network thread
+    // opened its socket.
+    connection.Handler->statistics().setName(channel->peerName());
+    this->connect(channel, SIGNAL(connected()), SLOT(onChannelConnected()));
+    }
+  else
+    {
+    connection.Handler->statistics().setName(QString("%1 #%2")
+      .arg(this->Internal->ServerName).arg(++this->Internal->LocalConnections));
+    }
+
+  connection.Socket = socket;
+  connection.Handler->setSocket(socket);
+  connection.Handler->onSocketOpened();
+  this->Internal->Connections.append(connection);
+
+  this->connect(socket, SIGNAL(readyRead()), SLOT(onSocketReadReady()));
+  this->connect(socket, SIGNAL(disconnected()), SLOT(onSocketClosed()));
+
+  // Without a scheduler nothing reads the socket, the messages wait there.
+  if (this->Internal->Scheduler)
+    {
+    this->Internal->Scheduler->addHandler(connection.Handler);
+    if (socket->bytesAvailable())
+      {
+      this->Internal->Scheduler->readReady(connection.Handler);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::removeConnection(int index)
+{
+  pqInternal::pqConnection connection = this->Internal->Connections.takeAt(index);
+
+  this->disconnect(connection.Socket, 0, this, 0);
+  if (this->Internal->Scheduler)
+    {
+    this->Internal->Scheduler->removeHandler(connection.Handler);
+    }
+  connection.Handler->setSocket(0);
+  connection.Handler->onSocketClosed();
+  connection.Socket->close();
+  connection.Socket->deleteLater();
+
+  // A handler that is in the middle of a message is deleted by the scheduler
+  // once the message returns.
+  if (!connection.Handler->isExecuting())
+    {
+    connection.Handler->deleteLater();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::closeConnections()
+{
+  while (!this->Internal->Connections.isEmpty())
+    {
+    this->removeConnection(0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onSocketClosed()
+{
+  int index = this->Internal->indexOf(this->sender());
+  if (index < 0)
+    {
+    return;
+    }
+  this->removeConnection(index);
+
+  if (this->isClient())
+    {
+    this->connectionLost(
+      QString("The connection to %1 was closed.").arg(this->Internal->endpoint()));
+    }
+  else
+    {
+    this->updateStatus();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onChannelConnected()
+{
+  int index = this->Internal->indexOf(this->sender());
+  if (index >= 0)
+    {
+    pqSocketIOChannel* channel = static_cast<pqSocketIOChannel*>(this->sender());
+    this->Internal->Connections[index].Handler->statistics().setName(channel->peerName());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEndpoint::onSocketReadReady()
+{
+  int index = this->Internal->indexOf(this->sender());
+  if (index < 0 || !this->Internal->Scheduler)
+    {
+    return;
+    }
+
+  this->Internal->Scheduler->readReady(this->Internal->Connections[index].Handler);
+}
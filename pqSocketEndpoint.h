@@ -0,0 +1,139 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketEndpoint.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketEndpoint_h
+#define _pqSocketEndpoint_h
+
+#include "pqSocketHandler.h"
+
+class QIODevice;
+class pqSocketIOChannel;
+class pqSocketIOThread;
+class pqSocketScheduler;
+
+// One end of the remote control without any widgets: it listens for clients
+// or connects to a server and gives every connection a handler of its own,
+// created from a prototype.  pqSocketItem drives it from a row of the dock,
+// the benchmark drives it directly.
+//
+// A client connects in the background and, with retry set, reconnects after
+// a failure or a lost connection.  status() and detail() describe the state
+// for display; stopped() is emitted when a client gives up on its own.
+class pqSocketEndpoint : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  enum SocketType
+    {
+    ClientSocket,
+    ServerSocket,
+    LocalClientSocket,
+    LocalServerSocket
+    };
+
+  pqSocketEndpoint(QObject* parent);
+  virtual ~pqSocketEndpoint();
+
+  // Settings used by the next start().  The port is the socket name for the
+  // local types, the handler is the prototype of the connections' handlers.
+  void setSocketType(SocketType type);
+  SocketType socketType() const;
+  void setProtocol(pqSocketHandler::ProtocolType protocol);
+  void setHandler(pqSocketHandler* prototype);
+  void setAddress(const QString& host, const QString& port);
+  void setMaximumClients(int clients);
+  void setRetry(bool retry);
+
+  // Executes the messages of all connections.
+  void setScheduler(pqSocketScheduler* scheduler);
+
+  // Connections opened while set do their network I/O in that thread.
+  void setIOThread(pqSocketIOThread* thread);
+
+  // Connects or starts listening.  Returns false if the address is invalid
+  // or listening failed, errorString() then tells why.
+  bool start();
+  void stop();
+  bool isStarted() const;
+  QString errorString() const;
+
+  int connectionCount() const;
+
+  // Short state, such as "Connecting" or "3 clients", and the reason of the
+  // last failure or the address connected to.
+  QString status() const;
+  QString detail() const;
+
+  bool isClient() const;
+  bool isLocal() const;
+
+signals:
+
+  void statusChanged();
+
+  // A client that failed to connect or lost its connection without retry.
+  void stopped(const QString& reason);
+
+protected slots:
+
+  void startConnecting();
+  void onConnected();
+  void onConnectError();
+
+  void onNewConnection();
+  void onNewDescriptor(quintptr descriptor);
+  void onChannelConnected();
+  void onSocketReadReady();
+  void onSocketClosed();
+
+protected:
+
+  bool openListeningSocket();
+  bool connectToHost();
+  void stopConnecting();
+  void connectionLost(const QString& reason);
+  void setStatus(const QString& status, const QString& detail);
+  void updateStatus();
+
+  pqSocketHandler* newHandler();
+  pqSocketIOChannel* newChannel(pqSocketHandler* handler);
+  void addConnection(pqSocketHandler* handler, QIODevice* socket);
+  void removeConnection(int index);
+  void closeConnections();
+
+private:
+  class pqInternal;
+  pqInternal* Internal;
+};
+
+#endif
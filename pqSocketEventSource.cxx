@@ -0,0 +1,170 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketEventSource.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketEventSource.h"
+#include "pqSocketHandler.h"
+#include "pqSocketMessage.h"
+
+#include <pqAnimationManager.h>
+#include <pqAnimationScene.h>
+#include <pqApplicationCore.h>
+#include <pqPipelineSource.h>
+#include <pqPVApplicationCore.h>
+#include <pqServerManagerModel.h>
+#include <pqView.h>
+
+#include <vtkCommand.h>
+#include <vtkEventQtSlotConnect.h>
+#include <vtkSMProxy.h>
+
+//-----------------------------------------------------------------------------
+pqSocketEventSource::pqSocketEventSource(QObject* parent) : QObject(parent)
+{
+  this->PropertyConnections = vtkEventQtSlotConnect::New();
+
+  pqSocketHandler::registerEvent("time");
+  pqSocketHandler::registerEvent("property");
+  pqSocketHandler::registerEvent("pipeline");
+  pqSocketHandler::registerEvent("render");
+
+  pqServerManagerModel* model = pqApplicationCore::instance()->getServerManagerModel();
+  this->connect(model, SIGNAL(sourceAdded(pqPipelineSource*)),
+                SLOT(onSourceAdded(pqPipelineSource*)));
+  this->connect(model, SIGNAL(preSourceRemoved(pqPipelineSource*)),
+                SLOT(onSourceRemoved(pqPipelineSource*)));
+  this->connect(model, SIGNAL(viewAdded(pqView*)), SLOT(onViewAdded(pqView*)));
+  foreach (pqPipelineSource* source, model->findItems<pqPipelineSource*>())
+    {
+    this->onSourceAdded(source);
+    }
+  foreach (pqView* view, model->findItems<pqView*>())
+    {
+    this->onViewAdded(view);
+    }
+
+  pqAnimationManager* animation = pqPVApplicationCore::instance()->animationManager();
+  this->connect(animation, SIGNAL(activeSceneChanged(pqAnimationScene*)),
+                SLOT(onActiveSceneChanged(pqAnimationScene*)));
+  this->onActiveSceneChanged(animation->getActiveScene());
+}
+
+//-----------------------------------------------------------------------------
+pqSocketEventSource::~pqSocketEventSource()
+{
+  this->PropertyConnections->Delete();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onSourceAdded(pqPipelineSource* source)
+{
+  this->connect(source, SIGNAL(dataUpdated(pqPipelineSource*)),
+                SLOT(onDataUpdated(pqPipelineSource*)));
+  this->PropertyConnections->Connect(source->getProxy(), vtkCommand::PropertyModifiedEvent,
+    this, SLOT(onPropertyModified(vtkObject*, unsigned long, void*, void*)));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onSourceRemoved(pqPipelineSource* source)
+{
+  this->PropertyConnections->Disconnect(source->getProxy());
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onViewAdded(pqView* view)
+{
+  this->connect(view, SIGNAL(endRender()), SLOT(onEndRender()));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onActiveSceneChanged(pqAnimationScene* scene)
+{
+  if (scene)
+    {
+    this->connect(scene, SIGNAL(animationTime(double)), SLOT(onAnimationTime(double)),
+                  Qt::UniqueConnection);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onAnimationTime(double time)
+{
+  if (pqSocketHandler::hasSubscribers("time"))
+    {
+    pqSocketHandler::publishEvent("time", QString(),
+      QString("{\"event\": \"time\", \"time\": %1}").arg(time, 0, 'g', 17).toUtf8());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onPropertyModified(vtkObject* object, unsigned long,
+                                             void*, void* callData)
+{
+  if (!pqSocketHandler::hasSubscribers("property") || !callData)
+    {
+    return;
+    }
+
+  pqServerManagerModel* model = pqApplicationCore::instance()->getServerManagerModel();
+  pqPipelineSource* source =
+    model->findItem<pqPipelineSource*>(vtkSMProxy::SafeDownCast(object));
+  if (!source)
+    {
+    return;
+    }
+  QString property = static_cast<const char*>(callData);
+  pqSocketHandler::publishEvent("property", source->getSMName() + "/" + property,
+    QString("{\"event\": \"property\", \"proxy\": %1, \"property\": %2}")
+      .arg(pqSocketJSONString(source->getSMName()), pqSocketJSONString(property)).toUtf8());
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onDataUpdated(pqPipelineSource* source)
+{
+  if (pqSocketHandler::hasSubscribers("pipeline"))
+    {
+    pqSocketHandler::publishEvent("pipeline", source->getSMName(),
+      QString("{\"event\": \"pipeline\", \"proxy\": %1}")
+        .arg(pqSocketJSONString(source->getSMName())).toUtf8());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketEventSource::onEndRender()
+{
+  pqView* view = qobject_cast<pqView*>(this->sender());
+  if (view && pqSocketHandler::hasSubscribers("render"))
+    {
+    pqSocketHandler::publishEvent("render", view->getSMName(),
+      QString("{\"event\": \"render\", \"view\": %1}")
+        .arg(pqSocketJSONString(view->getSMName())).toUtf8());
+    }
+}
@@ -0,0 +1,80 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketEventSource.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketEventSource_h
+#define _pqSocketEventSource_h
+
+#include <QObject>
+
+class pqAnimationScene;
+class pqPipelineSource;
+class pqView;
+class vtkEventQtSlotConnect;
+class vtkObject;
+
+// Publishes ParaView events to the connections subscribed to them, see
+// pqSocketHandler::publishEvent().  The events and their JSON payloads:
+//
+//   time      {"event": "time", "time": t}, the animation time changed
+//   property  {"event": "property", "proxy": name, "property": name}, a
+//             property of a pipeline source was modified
+//   pipeline  {"event": "pipeline", "proxy": name}, a source was updated
+//   render    {"event": "render", "view": name}, a view finished rendering
+//
+// Payloads are only built when somebody subscribed to the event.
+class pqSocketEventSource : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketEventSource(QObject* parent);
+  virtual ~pqSocketEventSource();
+
+protected slots:
+
+  void onSourceAdded(pqPipelineSource* source);
+  void onSourceRemoved(pqPipelineSource* source);
+  void onViewAdded(pqView* view);
+  void onActiveSceneChanged(pqAnimationScene* scene);
+
+  void onAnimationTime(double time);
+  void onPropertyModified(vtkObject* proxy, unsigned long event, void* clientData,
+                          void* callData);
+  void onDataUpdated(pqPipelineSource* source);
+  void onEndRender();
+
+private:
+
+  vtkEventQtSlotConnect* PropertyConnections;
+};
+
+#endif
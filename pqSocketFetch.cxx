@@ -0,0 +1,350 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketFetch.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketFetch.h"
+#include "pqSocketMessage.h"
+
+#include <pqActiveObjects.h>
+#include <pqApplicationCore.h>
+#include <pqPipelineSource.h>
+#include <pqServerManagerModel.h>
+
+#include <vtkAlgorithm.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkPointSet.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <QStringList>
+#include <QtEndian>
+
+namespace
+{
+  // Reads the big-endian fields of the request.
+  struct pqRequestReader
+    {
+    const uchar* Position;
+    const uchar* End;
+
+    bool has(int bytes) const {return this->End - this->Position >= bytes;}
+
+    template <class T>
+    bool read(T& value)
+      {
+      if (!this->has(sizeof(T)))
+        {
+        return false;
+        }
+      value = qFromBigEndian<T>(this->Position);
+      this->Position += sizeof(T);
+      return true;
+      }
+
+    bool readString(QString& value)
+      {
+      quint16 length;
+      if (!this->read(length) || !this->has(length))
+        {
+        return false;
+        }
+      value = QString::fromUtf8(reinterpret_cast<const char*>(this->Position), length);
+      this->Position += length;
+      return true;
+      }
+    };
+
+  QString typeName(vtkDataArray* array)
+    {
+    bool isSigned = true;
+    switch (array->GetDataType())
+      {
+      case VTK_FLOAT:
+        return "float32";
+      case VTK_DOUBLE:
+        return "float64";
+      case VTK_UNSIGNED_CHAR:
+      case VTK_UNSIGNED_SHORT:
+      case VTK_UNSIGNED_INT:
+      case VTK_UNSIGNED_LONG:
+#ifdef VTK_UNSIGNED_LONG_LONG
+      case VTK_UNSIGNED_LONG_LONG:
+#endif
+        isSigned = false;
+        break;
+      default:
+        break;
+      }
+    return QString("%1int%2").arg(isSigned ? "" : "u").arg(8 * array->GetDataTypeSize());
+    }
+
+  QString jsonVector(const double* values)
+    {
+    return QString("[%1, %2, %3]").arg(values[0], 0, 'g', 17).arg(values[1], 0, 'g', 17)
+      .arg(values[2], 0, 'g', 17);
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketFetch::pqSocketFetch()
+{
+  this->Downcast = false;
+  this->ChunkSize = 1024*1024;
+  this->Current = 0;
+  this->Offset = 0;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketFetch::~pqSocketFetch()
+{
+}
+
+//-----------------------------------------------------------------------------
+pqSocketOutputStream* pqSocketFetch::create(const char* payload, int payloadSize,
+                                            QString& result, QString& error)
+{
+  pqSocketFetch* fetch = new pqSocketFetch;
+  if (!fetch->initialize(payload, payloadSize, error))
+    {
+    delete fetch;
+    return NULL;
+    }
+  result = fetch->description();
+  return fetch;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketFetch::initialize(const char* payload, int payloadSize, QString& error)
+{
+  pqRequestReader reader;
+  reader.Position = reinterpret_cast<const uchar*>(payload);
+  reader.End = reader.Position + payloadSize;
+
+  QString name;
+  quint16 port;
+  quint16 flags;
+  quint32 chunkSize;
+  quint16 count;
+  if (!reader.readString(name) || !reader.read(port) || !reader.read(flags)
+      || !reader.read(chunkSize) || !reader.read(count))
+    {
+    error = "The fetch request is truncated.";
+    return false;
+    }
+
+  // Chunks are whole doubles so that a downcast chunk is whole floats.
+  this->Downcast = (flags & DowncastFlag) != 0;
+  if (chunkSize)
+    {
+    this->ChunkSize = static_cast<int>(qBound<quint32>(4096, chunkSize, 16*1024*1024) & ~7u);
+    }
+
+  pqPipelineSource* source = name.isEmpty()
+    ? pqActiveObjects::instance().activeSource()
+    : pqApplicationCore::instance()->getServerManagerModel()->findItem<pqPipelineSource*>(name);
+  vtkSMSourceProxy* proxy = source ? vtkSMSourceProxy::SafeDownCast(source->getProxy()) : NULL;
+  if (!proxy)
+    {
+    error = name.isEmpty() ? QString("There is no active source.")
+                           : QString("There is no source named '%1'.").arg(name);
+    return false;
+    }
+  if (port >= proxy->GetNumberOfOutputPorts())
+    {
+    error = QString("%1 has no output port %2.").arg(source->getSMName()).arg(port);
+    return false;
+    }
+
+  proxy->UpdatePipeline();
+  vtkAlgorithm* algorithm = vtkAlgorithm::SafeDownCast(proxy->GetClientSideObject());
+  vtkDataSet* dataset = algorithm
+    ? vtkDataSet::SafeDownCast(algorithm->GetOutputDataObject(port)) : NULL;
+  if (!algorithm)
+    {
+    error = "Fetching data needs a builtin session.";
+    return false;
+    }
+  if (!dataset)
+    {
+    error = QString("The output of %1 is not a dataset.").arg(source->getSMName());
+    return false;
+    }
+
+  this->Dataset = QString("\"dataset\": %1, \"points\": %2, \"cells\": %3")
+    .arg(pqSocketJSONString(dataset->GetClassName()))
+    .arg(dataset->GetNumberOfPoints()).arg(dataset->GetNumberOfCells());
+  if (vtkImageData* image = vtkImageData::SafeDownCast(dataset))
+    {
+    double dimensions[3];
+    int* extent = image->GetExtent();
+    for (int i = 0; i < 3; ++i)
+      {
+      dimensions[i] = extent[2*i + 1] - extent[2*i] + 1;
+      }
+    this->Dataset += QString(", \"dimensions\": %1, \"origin\": %2, \"spacing\": %3")
+      .arg(jsonVector(dimensions), jsonVector(image->GetOrigin()), jsonVector(image->GetSpacing()));
+    }
+
+  if ((flags & PointsFlag) && vtkPointSet::SafeDownCast(dataset)
+      && vtkPointSet::SafeDownCast(dataset)->GetPoints())
+    {
+    this->addArray(vtkPointSet::SafeDownCast(dataset)->GetPoints()->GetData(), "Points", "geometry");
+    }
+  if (flags & CellsFlag)
+    {
+    if (vtkPolyData* polyData = vtkPolyData::SafeDownCast(dataset))
+      {
+      this->addArray(polyData->GetVerts()->GetData(), "Verts", "geometry");
+      this->addArray(polyData->GetLines()->GetData(), "Lines", "geometry");
+      this->addArray(polyData->GetPolys()->GetData(), "Polys", "geometry");
+      this->addArray(polyData->GetStrips()->GetData(), "Strips", "geometry");
+      }
+    else if (vtkUnstructuredGrid* grid = vtkUnstructuredGrid::SafeDownCast(dataset))
+      {
+      if (grid->GetCells())
+        {
+        this->addArray(grid->GetCells()->GetData(), "Cells", "geometry");
+        this->addArray(grid->GetCellTypesArray(), "CellTypes", "geometry");
+        }
+      }
+    }
+
+  const char* associations[] = {"points", "cells", "field"};
+  for (int i = 0; i < count; ++i)
+    {
+    quint8 association;
+    QString arrayName;
+    if (!reader.read(association) || !reader.readString(arrayName))
+      {
+      error = "The fetch request is truncated.";
+      return false;
+      }
+    vtkFieldData* data = association == 0 ? dataset->GetPointData()
+      : association == 1 ? static_cast<vtkFieldData*>(dataset->GetCellData())
+      : association == 2 ? dataset->GetFieldData() : NULL;
+    vtkDataArray* array = data ? data->GetArray(arrayName.toUtf8().constData()) : NULL;
+    if (!array)
+      {
+      error = QString("%1 has no %2 array named '%3'.").arg(source->getSMName())
+        .arg(association < 3 ? associations[association] : "such").arg(arrayName);
+      return false;
+      }
+    this->addArray(array, arrayName, associations[association]);
+    }
+
+  if (this->Arrays.size() > pqSocketMessageHeader::DataIndexMask + 1)
+    {
+    error = "Too many arrays in one fetch request.";
+    return false;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketFetch::addArray(vtkDataArray* array, const QString& name, const QString& association)
+{
+  if (!array)
+    {
+    return;
+    }
+
+  pqArray entry;
+  entry.Array = array;
+  entry.Name = name;
+  entry.Association = association;
+  entry.Downcast = this->Downcast && array->GetDataType() == VTK_DOUBLE;
+  entry.Size = static_cast<qint64>(array->GetNumberOfTuples()) * array->GetNumberOfComponents()
+    * (entry.Downcast ? sizeof(float) : array->GetDataTypeSize());
+  this->Arrays.append(entry);
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketFetch::description() const
+{
+  QStringList arrays;
+  foreach (const pqArray& entry, this->Arrays)
+    {
+    arrays.append(QString("{\"name\": %1, \"association\": \"%2\", \"type\": \"%3\", "
+                          "\"components\": %4, \"tuples\": %5, \"bytes\": %6}")
+      .arg(pqSocketJSONString(entry.Name), entry.Association,
+           entry.Downcast ? QString("float32") : typeName(entry.Array))
+      .arg(entry.Array->GetNumberOfComponents())
+      .arg(static_cast<qint64>(entry.Array->GetNumberOfTuples()))
+      .arg(entry.Size));
+    }
+  return QString("{%1, \"chunk_size\": %2, \"arrays\": [%3]}")
+    .arg(this->Dataset).arg(this->ChunkSize).arg(arrays.join(", "));
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketFetch::nextChunk(const char*& data, int& length, int& index)
+{
+  while (this->Current < this->Arrays.size()
+         && this->Offset >= this->Arrays[this->Current].Size)
+    {
+    this->Current++;
+    this->Offset = 0;
+    }
+  if (this->Current >= this->Arrays.size())
+    {
+    return false;
+    }
+
+  const pqArray& entry = this->Arrays[this->Current];
+  length = static_cast<int>(qMin<qint64>(this->ChunkSize, entry.Size - this->Offset));
+  if (entry.Downcast)
+    {
+    const double* values = static_cast<const double*>(entry.Array->GetVoidPointer(0))
+      + this->Offset / sizeof(float);
+    int count = length / sizeof(float);
+    this->Converted.resize(count);
+    for (int i = 0; i < count; ++i)
+      {
+      this->Converted[i] = static_cast<float>(values[i]);
+      }
+    data = reinterpret_cast<const char*>(this->Converted.constData());
+    }
+  else
+    {
+    data = static_cast<const char*>(entry.Array->GetVoidPointer(0)) + this->Offset;
+    }
+  index = this->Current;
+  this->Offset += length;
+  return true;
+}
@@ -0,0 +1,119 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketFetch.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketFetch_h
+#define _pqSocketFetch_h
+
+#include "pqSocketHandler.h"
+
+#include <vtkSmartPointer.h>
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class vtkDataArray;
+class vtkDataSet;
+
+// Streams arrays of the output of a pipeline source answering a
+// FetchMessage.  The request payload, with big-endian integers and strings
+// as a quint16 byte count followed by UTF-8:
+//
+//   string  source name as in the pipeline browser, empty for the active one
+//   quint16 output port
+//   quint16 flags: 1 sends doubles as floats, 2 adds the points, 4 adds the
+//           cells
+//   quint32 chunk size in bytes, 0 for 1 MB
+//   quint16 number of arrays, then for each
+//     quint8 association: 0 point data, 1 cell data, 2 field data
+//     string array name
+//
+// The reply's result describes the dataset and lists the arrays in the
+// order they are sent, with their element type, components, tuples and
+// size in bytes.  The chunks of every array follow as DataMessages whose
+// flags hold the array's index; their payload points directly into the
+// array's memory unless it is converted to floats.  Values are in
+// ParaView's native byte order.
+//
+// The arrays are referenced when the request is executed, so the stream is
+// a consistent snapshot even if the source updates in the meantime.
+// Fetching needs the data on the client, that is a builtin session.
+class pqSocketFetch : public pqSocketOutputStream
+{
+public:
+
+  enum Flags
+    {
+    DowncastFlag = 1,
+    PointsFlag = 2,
+    CellsFlag = 4
+    };
+
+  pqSocketFetch();
+  virtual ~pqSocketFetch();
+
+  // Parses the request and collects the arrays.  Returns false and sets
+  // error on failure.
+  bool initialize(const char* payload, int payloadSize, QString& error);
+
+  // JSON description of the dataset and the arrays.
+  QString description() const;
+
+  virtual bool nextChunk(const char*& data, int& length, int& index);
+
+  // Creates the stream of a FetchMessage for pqSocketHandler::createStream().
+  static pqSocketOutputStream* create(const char* payload, int payloadSize,
+                                      QString& result, QString& error);
+
+protected:
+
+  struct pqArray
+    {
+    vtkSmartPointer<vtkDataArray> Array;
+    QString Name;
+    QString Association;
+    bool Downcast;
+    qint64 Size;
+    };
+
+  void addArray(vtkDataArray* array, const QString& name, const QString& association);
+
+  QList<pqArray> Arrays;
+  QString Dataset;
+  QString Extra;
+  bool Downcast;
+  int ChunkSize;
+  int Current;
+  qint64 Offset;
+  QVector<float> Converted;
+};
+
+#endif
@@ -0,0 +1,1012 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketHandler.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketHandler.h"
+#include "pqSocketIOThread.h"
+#include "pqSocketJournal.h"
+#include "pqSocketMessage.h"
+
+#include <QAbstractSocket>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTimer>
+
+namespace
+{
+  pqSocketJournal* Journal = 0;
+  pqSocketHandler::InterruptFunction Interrupt = 0;
+  quint32 NextConnectionId = 1;
+
+  QStringList EventNames;
+  QList<pqSocketHandler*> Subscribers;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHandler::pqSocketHandler(QObject* parent) : QObject(parent)
+{
+  this->Socket = NULL;
+  this->Protocol = RawProtocol;
+  this->Executing = false;
+  this->HoldingMessages = false;
+  this->ReadingPaused = false;
+  this->OutputBlocked = false;
+  this->Policy = PauseOutput;
+  this->OutputLowWaterMark = 1024*1024;
+  this->OutputHighWaterMark = 16*1024*1024;
+  this->Compression = NoCompression;
+  this->CompressionThreshold = 1024;
+  this->ConnectionId = NextConnectionId++;
+  this->EventInterval = 0;
+  this->EventTimer = new QTimer(this);
+  this->EventTimer->setSingleShot(true);
+  this->connect(this->EventTimer, SIGNAL(timeout()), SLOT(sendPendingEvents()));
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHandler::~pqSocketHandler()
+{
+  Subscribers.removeAll(this);
+  this->deleteStreams();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::setSocket(QIODevice* socket)
+{
+  if (this->Socket)
+    {
+    this->disconnect(this->Socket, 0, this, 0);
+    }
+  this->Socket = socket;
+  this->OutputBlocked = false;
+  if (this->Socket)
+    {
+    this->connect(this->Socket, SIGNAL(bytesWritten(qint64)), SLOT(onBytesWritten()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::setOutputWaterMarks(qint64 low, qint64 high)
+{
+  this->OutputLowWaterMark = qMin(low, high);
+  this->OutputHighWaterMark = high;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketHandler::outputBuffered() const
+{
+  return this->Socket ? this->Socket->bytesToWrite() : 0;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::updateOutputBuffered()
+{
+  this->Statistics.OutputBuffered = this->outputBuffered();
+  this->Statistics.MaximumOutputBuffered =
+    qMax(this->Statistics.MaximumOutputBuffered, this->Statistics.OutputBuffered);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::onBytesWritten()
+{
+  this->updateOutputBuffered();
+  if (this->OutputBlocked && this->Statistics.OutputBuffered <= this->OutputLowWaterMark)
+    {
+    this->OutputBlocked = false;
+    this->updateReadBuffer();
+    emit this->outputDrained();
+    }
+  this->pumpStreams();
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketHandler::currentTime()
+{
+  static QElapsedTimer clock;
+  if (!clock.isValid())
+    {
+    clock.start();
+    }
+  return clock.nsecsElapsed() / 1000;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketHandler::headerSize() const
+{
+  switch (this->Protocol)
+    {
+    case FramedProtocol:
+      return 4;
+    case RequestProtocol:
+      return pqSocketMessageHeader::Size;
+    default:
+      return 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::writeMessage(const pqSocketMessageHeader& header,
+                                   const char* data, int length, bool droppable)
+{
+  if (!this->Socket)
+    {
+    return false;
+    }
+
+  // The socket buffers everything that the client has not read yet, a
+  // client that falls behind would make it grow without bound.
+  if (this->outputBuffered() >= this->OutputHighWaterMark)
+    {
+    if (this->Policy == DisconnectOutput)
+      {
+      qWarning() << "Remote control: disconnecting" << this->Statistics.name()
+                 << ", it does not read its replies.";
+      this->Statistics.OutputStalls++;
+      if (QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(this->Socket))
+        {
+        socket->abort();
+        }
+      else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(this->Socket))
+        {
+        socket->abort();
+        }
+      else if (pqSocketIOChannel* channel = qobject_cast<pqSocketIOChannel*>(this->Socket))
+        {
+        channel->abort();
+        }
+      else
+        {
+        this->Socket->close();
+        }
+      return false;
+      }
+    if (this->Policy == DropFramesOutput && droppable)
+      {
+      this->Statistics.FramesDropped++;
+      return false;
+      }
+    if (this->Policy == PauseOutput && !this->OutputBlocked)
+      {
+      this->Statistics.OutputStalls++;
+      this->OutputBlocked = true;
+      this->updateReadBuffer();
+      }
+    }
+
+  // Compression is only kept when it actually saves bytes, the flag in the
+  // header tells the client which payloads to uncompress.
+  QByteArray compressed;
+  pqSocketMessageHeader replyHeader = header;
+  if (this->Protocol == RequestProtocol && this->Compression != NoCompression
+      && length >= this->CompressionThreshold)
+    {
+    qint64 start = currentTime();
+    compressed = qCompress(reinterpret_cast<const uchar*>(data), length,
+                           this->Compression == FastCompression ? 1 : 6);
+    this->Statistics.CompressionTime += currentTime() - start;
+    if (compressed.size() < length)
+      {
+      this->Statistics.UncompressedBytesOut += length;
+      this->Statistics.CompressedBytesOut += compressed.size();
+      replyHeader.Flags |= pqSocketMessageHeader::CompressedFlag;
+      data = compressed.constData();
+      length = compressed.size();
+      }
+    }
+
+  char headerBytes[pqSocketMessageHeader::Size];
+  if (this->Protocol == FramedProtocol)
+    {
+    qToBigEndian<quint32>(static_cast<quint32>(length),
+                          reinterpret_cast<uchar*>(headerBytes));
+    this->Socket->write(headerBytes, 4);
+    }
+  else if (this->Protocol == RequestProtocol)
+    {
+    replyHeader.PayloadSize = static_cast<quint32>(length);
+    replyHeader.encode(headerBytes);
+    this->Socket->write(headerBytes, pqSocketMessageHeader::Size);
+    }
+
+  this->Socket->write(data, length);
+
+  this->Statistics.MessagesSent++;
+  this->Statistics.BytesSent += length + this->headerSize();
+  if (header.Type == pqSocketMessageHeader::ReplyMessage)
+    {
+    this->Statistics.ReplySize.add(length);
+    }
+  this->updateOutputBuffered();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::onSocketOpened()
+{
+  this->ReceiveBuffer.clear();
+  this->ReceiveBuffer.setHeaderSize(this->headerSize());
+  this->Statistics.reset();
+  this->Statistics.setOpen(true);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::onSocketClosed()
+{
+  this->unsubscribeAll();
+  this->deleteStreams();
+  this->ReceiveBuffer.clear();
+  this->CancelledRequests.clear();
+  this->HoldingMessages = false;
+  this->Statistics.setOpen(false);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::onSocketReadReady()
+{
+  // A message may spin the event loop (progress events while rendering).
+  // Reading would move the payload being executed, so new bytes are picked
+  // up once the message returns.
+  if (this->Executing || this->ReadingPaused || this->OutputBlocked || !this->Socket)
+    {
+    return;
+    }
+
+  int before = this->ReceiveBuffer.frameCount();
+  bool valid = true;
+  if (pqSocketIOChannel* channel = qobject_cast<pqSocketIOChannel*>(this->Socket))
+    {
+    // The network thread already framed the bytes, its buffers are queued
+    // as they are.  Frames it uncompressed count as received compressed.
+    qint64 arrivalTime = currentTime();
+    pqSocketIOFrame frame;
+    while (channel->takeFrame(frame))
+      {
+      this->ReceiveBuffer.appendFrame(frame.Data, arrivalTime);
+      if (frame.CompressedSize)
+        {
+        int headerSize = this->headerSize();
+        this->Statistics.BytesReceived += headerSize + frame.CompressedSize;
+        this->Statistics.CompressedBytesIn += frame.CompressedSize;
+        this->Statistics.UncompressedBytesIn += frame.Data.size() - headerSize;
+        this->Statistics.CompressionTime += frame.CompressionTime;
+        }
+      else
+        {
+        this->Statistics.BytesReceived += frame.Data.size();
+        }
+      }
+    }
+  else
+    {
+    quint64 received = this->ReceiveBuffer.bytesReceived();
+    valid = this->ReceiveBuffer.readFrom(this->Socket, currentTime());
+    this->Statistics.BytesReceived += this->ReceiveBuffer.bytesReceived() - received;
+    }
+
+  // A cancel takes effect as soon as it arrives, ahead of the requests
+  // queued before it.
+  if (this->Protocol == RequestProtocol)
+    {
+    for (int i = before; i < this->ReceiveBuffer.frameCount(); ++i)
+      {
+      pqSocketMessageHeader header;
+      header.decode(this->ReceiveBuffer.frameHeader(i));
+      if (header.Type == pqSocketMessageHeader::CancelMessage)
+        {
+        this->cancelRequest(header.RequestId, i);
+        }
+      }
+    }
+  if (!valid)
+    {
+    qCritical("Closing remote control socket: received a message larger than %d bytes.",
+              this->ReceiveBuffer.maximumPayloadSize());
+    this->Socket->close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::hasPendingMessage() const
+{
+  return this->Socket && !this->Executing && !this->HoldingMessages && !this->OutputBlocked
+    && this->ReceiveBuffer.hasFrame();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::holdMessages(bool hold)
+{
+  if (this->HoldingMessages != hold)
+    {
+    this->HoldingMessages = hold;
+    if (!hold)
+      {
+      emit this->messagesReleased();
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketHandler::pendingMessageCount() const
+{
+  return this->Socket ? this->ReceiveBuffer.frameCount() : 0;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketHandler::nextMessageArrivalTime() const
+{
+  return this->ReceiveBuffer.hasFrame() ? this->ReceiveBuffer.arrivalTime() : 0;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketHandler::nextMessagePriority() const
+{
+  if (this->Protocol != RequestProtocol || !this->ReceiveBuffer.hasFrame())
+    {
+    return 0;
+    }
+  pqSocketMessageHeader header;
+  header.decode(this->ReceiveBuffer.header());
+  return (header.Flags & pqSocketMessageHeader::PriorityMask) >> pqSocketMessageHeader::PriorityShift;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::discardNewestMessages(int count)
+{
+  this->ReceiveBuffer.discardFrames(this->ReceiveBuffer.frameCount() - count);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::setReadingPaused(bool paused)
+{
+  if (this->ReadingPaused == paused)
+    {
+    return;
+    }
+  this->ReadingPaused = paused;
+  this->updateReadBuffer();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::updateReadBuffer()
+{
+  if (!this->Socket)
+    {
+    return;
+    }
+
+  bool paused = this->ReadingPaused || this->OutputBlocked;
+  qint64 size = paused ? 64*1024 : 0;
+  if (QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(this->Socket))
+    {
+    socket->setReadBufferSize(size);
+    }
+  else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(this->Socket))
+    {
+    socket->setReadBufferSize(size);
+    }
+  if (!paused)
+    {
+    this->onSocketReadReady();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::processNextMessage()
+{
+  if (!this->hasPendingMessage())
+    {
+    return;
+    }
+
+  pqSocketMessageHeader header;
+  if (this->Protocol == RequestProtocol)
+    {
+    header.decode(this->ReceiveBuffer.header());
+    }
+
+  // Popping only moves the read offset, or keeps a frame from the network
+  // thread alive; the payload stays in place until the next read, which
+  // cannot happen while Executing is set.
+  const char* payload = this->ReceiveBuffer.payload();
+  int payloadSize = this->ReceiveBuffer.payloadSize();
+  bool discarded = this->ReceiveBuffer.isDiscarded();
+  qint64 start = currentTime();
+  qint64 wait = start - this->ReceiveBuffer.arrivalTime();
+  this->ReceiveBuffer.popFrame();
+
+  this->Executing = true;
+  if (discarded && this->CancelledRequests.remove(header.RequestId))
+    {
+    this->writeErrorReply(header, "The request was cancelled before it started.");
+    }
+  else if (discarded)
+    {
+    this->Statistics.MessagesRejected++;
+    this->rejectMessage(header);
+    }
+  else if (header.Flags & pqSocketMessageHeader::CompressedFlag)
+    {
+    // qCompress() stores the uncompressed size in the first four bytes, it
+    // is checked before allocating so that a small message cannot claim an
+    // arbitrary amount of memory.
+    quint32 size = payloadSize >= 4
+      ? qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(payload)) : 0;
+    if (this->Compression == NoCompression)
+      {
+      this->writeErrorReply(header, "Compression was not negotiated for this connection.");
+      }
+    else if (size > static_cast<quint32>(this->ReceiveBuffer.maximumPayloadSize()))
+      {
+      this->writeErrorReply(header, "The uncompressed message is too large.");
+      }
+    else
+      {
+      qint64 start = currentTime();
+      this->UncompressedPayload = qUncompress(
+        reinterpret_cast<const uchar*>(payload), payloadSize);
+      this->Statistics.CompressionTime += currentTime() - start;
+      if (this->UncompressedPayload.size() != static_cast<int>(size))
+        {
+        this->writeErrorReply(header, "The compressed message is corrupt.");
+        }
+      else
+        {
+        this->Statistics.CompressedBytesIn += payloadSize;
+        this->Statistics.UncompressedBytesIn += size;
+        header.Flags &= ~pqSocketMessageHeader::CompressedFlag;
+        payload = this->UncompressedPayload.constData();
+        payloadSize = this->UncompressedPayload.size();
+        }
+      }
+    }
+
+  if (!discarded && !(header.Flags & pqSocketMessageHeader::CompressedFlag))
+    {
+    // The message is journaled before it runs, so that the journal of a
+    // session it crashes ends with it.
+    qint64 record = -1;
+    if (Journal && Journal->isOpen())
+      {
+      if (!Journal->hasConnection(this->ConnectionId))
+        {
+        Journal->recordConnection(this->ConnectionId, this->Protocol,
+                                  this->metaObject()->className(), this->Statistics.name());
+        }
+      record = Journal->recordMessage(this->ConnectionId, this->Protocol, header,
+                                      payload, payloadSize, start - wait);
+      }
+
+    this->dispatchMessage(header, payload, payloadSize);
+    qint64 execute = currentTime() - start;
+
+    // Only scripts are worth quoting as the slowest message.
+    bool script = this->Protocol != RequestProtocol
+      || header.Type == pqSocketMessageHeader::ScriptMessage;
+    this->Statistics.addMessage(wait, execute, script ? payload : NULL, payloadSize);
+
+    if (record >= 0 && Journal && Journal->isOpen())
+      {
+      Journal->recordExecuteTime(record, execute);
+      }
+    }
+  this->UncompressedPayload.clear();
+  this->Executing = false;
+
+  if (this->Socket && this->Socket->bytesAvailable())
+    {
+    this->onSocketReadReady();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::dispatchMessage(const pqSocketMessageHeader& header,
+                                      const char* payload, int payloadSize)
+{
+  if (this->Protocol == RequestProtocol
+      && header.Type == pqSocketMessageHeader::ConfigureMessage)
+    {
+    this->executeConfigure(header, payload, payloadSize);
+    }
+  else if (this->Protocol == RequestProtocol
+           && header.Type == pqSocketMessageHeader::StatisticsMessage)
+    {
+    this->executeStatisticsRequest(header);
+    }
+  else if (this->Protocol == RequestProtocol
+           && header.Type == pqSocketMessageHeader::FetchMessage)
+    {
+    this->executeFetch(header, payload, payloadSize);
+    }
+  else if (this->Protocol == RequestProtocol
+           && header.Type == pqSocketMessageHeader::CancelMessage)
+    {
+    // Already done when it was received, see onSocketReadReady().
+    }
+  else
+    {
+    this->executeMessage(header, payload, payloadSize);
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketOutputStream* pqSocketHandler::createStream(const pqSocketMessageHeader&,
+                                                    const char*, int,
+                                                    QString&, QString& error)
+{
+  error = "This connection does not support fetching data.";
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::executeFetch(const pqSocketMessageHeader& header,
+                                   const char* payload, int payloadSize)
+{
+  QString result;
+  QString error;
+  pqSocketOutputStream* stream = this->createStream(header, payload, payloadSize, result, error);
+  if (!stream)
+    {
+    this->writeErrorReply(header, error);
+    return;
+    }
+
+  QByteArray reply = QString("{\"result\": %1, \"stdout\": \"\", \"stderr\": \"\", "
+                             "\"exception\": null, \"time\": 0}").arg(result).toUtf8();
+  this->writeMessage(pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+  this->Streams.append(qMakePair(header.RequestId, stream));
+  this->pumpStreams();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::pumpStreams()
+{
+  // Called again from onBytesWritten() as the client reads, so a large fetch
+  // never holds more than the low water mark in the output buffer and
+  // messages of the connection, such as a cancel, are served in between.
+  while (this->Socket && !this->Streams.isEmpty()
+         && this->outputBuffered() < this->OutputLowWaterMark)
+    {
+    QPair<quint32, pqSocketOutputStream*> stream = this->Streams.first();
+    const char* data;
+    int length;
+    int index;
+    if (stream.second->nextChunk(data, length, index))
+      {
+      this->writeMessage(pqSocketMessageHeader(stream.first, pqSocketMessageHeader::DataMessage,
+                           static_cast<quint16>(index & pqSocketMessageHeader::DataIndexMask)),
+                         data, length);
+      continue;
+      }
+    this->Streams.removeFirst();
+    delete stream.second;
+    this->writeMessage(pqSocketMessageHeader(stream.first, pqSocketMessageHeader::DataMessage,
+                                             pqSocketMessageHeader::EndOfDataFlag), "", 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::cancelStream(quint32 requestId)
+{
+  for (int i = 0; i < this->Streams.size(); ++i)
+    {
+    if (this->Streams[i].first == requestId)
+      {
+      delete this->Streams.takeAt(i).second;
+      this->writeMessage(pqSocketMessageHeader(requestId, pqSocketMessageHeader::DataMessage,
+        pqSocketMessageHeader::EndOfDataFlag | pqSocketMessageHeader::CancelledFlag), "", 0);
+      return true;
+      }
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::cancelRequest(quint32 requestId, int queuedMessages)
+{
+  bool cancelled = this->cancelStream(requestId);
+  for (int i = 0; i < queuedMessages; ++i)
+    {
+    pqSocketMessageHeader header;
+    header.decode(this->ReceiveBuffer.frameHeader(i));
+    if (header.RequestId == requestId && header.Type != pqSocketMessageHeader::CancelMessage)
+      {
+      this->ReceiveBuffer.discardFrame(i);
+      this->CancelledRequests.insert(requestId);
+      cancelled = true;
+      }
+    }
+  if (!cancelled)
+    {
+    cancelled = interruptRequest(this->ConnectionId, requestId);
+    }
+  if (cancelled)
+    {
+    this->Statistics.RequestsCancelled++;
+    }
+  return cancelled;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::setInterruptFunction(InterruptFunction function)
+{
+  Interrupt = function;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::interruptRequest(quint32 connectionId, quint32 requestId)
+{
+  return Interrupt && Interrupt(connectionId, requestId);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::deleteStreams()
+{
+  for (int i = 0; i < this->Streams.size(); ++i)
+    {
+    delete this->Streams[i].second;
+    }
+  this->Streams.clear();
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketHandler::replayMessage(const pqSocketMessageHeader& header,
+                                      const char* payload, int payloadSize)
+{
+  qint64 start = currentTime();
+  this->Executing = true;
+  this->dispatchMessage(header, payload, payloadSize);
+  this->Executing = false;
+  return currentTime() - start;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::setJournal(pqSocketJournal* journal)
+{
+  Journal = journal;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournal* pqSocketHandler::journal()
+{
+  return Journal;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::rejectMessage(const pqSocketMessageHeader& header)
+{
+  if (this->Protocol == RequestProtocol)
+    {
+    this->writeErrorReply(header, "The remote control queue is full, the request was rejected.");
+    }
+  else
+    {
+    qWarning("Remote control: the queue is full, a message was rejected.");
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::writeErrorReply(const pqSocketMessageHeader& request,
+                                      const QString& message)
+{
+  if (this->Protocol != RequestProtocol)
+    {
+    return;
+    }
+
+  QByteArray reply = QString("{\"result\": null, \"stdout\": \"\", \"stderr\": \"\", "
+                             "\"exception\": %1, \"time\": 0}")
+    .arg(pqSocketJSONString(message)).toUtf8();
+  this->writeMessage(pqSocketMessageHeader(request.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::configure(const QString& key, const QString& value)
+{
+  if (key == "compression")
+    {
+    if (value == "none")
+      {
+      this->Compression = NoCompression;
+      }
+    else if (value == "zlib")
+      {
+      this->Compression = ZlibCompression;
+      }
+    else if (value == "fast")
+      {
+      this->Compression = FastCompression;
+      }
+    else
+      {
+      return false;
+      }
+    if (pqSocketIOChannel* channel = qobject_cast<pqSocketIOChannel*>(this->Socket))
+      {
+      channel->setDecompressing(this->Compression != NoCompression);
+      }
+    return true;
+    }
+  if (key == "compression_threshold")
+    {
+    bool ok;
+    int threshold = value.toInt(&ok);
+    if (ok && threshold >= 0)
+      {
+      this->CompressionThreshold = threshold;
+      }
+    return ok && threshold >= 0;
+    }
+  if (key == "output_policy")
+    {
+    if (value == "pause")
+      {
+      this->Policy = PauseOutput;
+      }
+    else if (value == "drop")
+      {
+      this->Policy = DropFramesOutput;
+      }
+    else if (value == "disconnect")
+      {
+      this->Policy = DisconnectOutput;
+      }
+    else
+      {
+      return false;
+      }
+    return true;
+    }
+  if (key == "output_low_water" || key == "output_high_water")
+    {
+    bool ok;
+    qint64 bytes = value.toLongLong(&ok);
+    if (!ok || bytes <= 0)
+      {
+      return false;
+      }
+    if (key == "output_low_water")
+      {
+      this->setOutputWaterMarks(bytes, this->OutputHighWaterMark);
+      }
+    else
+      {
+      this->setOutputWaterMarks(this->OutputLowWaterMark, bytes);
+      }
+    return true;
+    }
+  if ((key == "subscribe" || key == "unsubscribe") && this->Protocol == RequestProtocol)
+    {
+    QStringList names = value.split(',', QString::SkipEmptyParts);
+    for (int i = 0; i < names.size(); ++i)
+      {
+      names[i] = names[i].trimmed();
+      if (!EventNames.contains(names[i]))
+        {
+        return false;
+        }
+      }
+    foreach (QString name, names)
+      {
+      if (key == "subscribe")
+        {
+        this->Subscriptions.insert(name);
+        }
+      else
+        {
+        this->Subscriptions.remove(name);
+        }
+      }
+    if (this->Subscriptions.isEmpty())
+      {
+      this->unsubscribeAll();
+      }
+    else if (!Subscribers.contains(this))
+      {
+      Subscribers.append(this);
+      }
+    return true;
+    }
+  if (key == "event_interval")
+    {
+    bool ok;
+    int interval = value.toInt(&ok);
+    if (ok && interval >= 0)
+      {
+      this->EventInterval = interval;
+      }
+    return ok && interval >= 0;
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::registerEvent(const QString& name)
+{
+  if (!EventNames.contains(name))
+    {
+    EventNames.append(name);
+    }
+}
+
+//-----------------------------------------------------------------------------
+QStringList pqSocketHandler::eventNames()
+{
+  return EventNames;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketHandler::hasSubscribers(const QString& name)
+{
+  foreach (pqSocketHandler* handler, Subscribers)
+    {
+    if (handler->Subscriptions.contains(name))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::publishEvent(const QString& name, const QString& key,
+                                   const QByteArray& payload)
+{
+  // Writing may close a connection and unsubscribe it, the loop runs over a
+  // copy of the list.
+  QList<pqSocketHandler*> subscribers = Subscribers;
+  foreach (pqSocketHandler* handler, subscribers)
+    {
+    if (handler->Subscriptions.contains(name))
+      {
+      handler->pushEvent(name, key, payload);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::pushEvent(const QString& name, const QString& key,
+                                const QByteArray& payload)
+{
+  QString id = QString("%1/%2").arg(name, key);
+  if (this->EventInterval > 0)
+    {
+    qint64 now = currentTime() / 1000;
+    if (this->PendingEvents.contains(id))
+      {
+      this->PendingEvents[id] = payload;
+      this->Statistics.EventsCoalesced++;
+      return;
+      }
+    QMap<QString, qint64>::const_iterator last = this->EventTimes.find(id);
+    if (last != this->EventTimes.end() && now - last.value() < this->EventInterval)
+      {
+      this->PendingEvents.insert(id, payload);
+      if (!this->EventTimer->isActive())
+        {
+        this->EventTimer->start(static_cast<int>(last.value() + this->EventInterval - now));
+        }
+      return;
+      }
+    this->EventTimes[id] = now;
+    }
+
+  this->writeMessage(pqSocketMessageHeader(0, pqSocketMessageHeader::EventMessage),
+                     payload.constData(), payload.size());
+  this->Statistics.EventsSent++;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::sendPendingEvents()
+{
+  qint64 now = currentTime() / 1000;
+  qint64 next = -1;
+  QMap<QString, QByteArray>::iterator iter = this->PendingEvents.begin();
+  while (iter != this->PendingEvents.end())
+    {
+    qint64 due = this->EventTimes.value(iter.key()) + this->EventInterval;
+    if (due > now)
+      {
+      next = next < 0 ? due - now : qMin(next, due - now);
+      ++iter;
+      continue;
+      }
+    this->EventTimes[iter.key()] = now;
+    this->writeMessage(pqSocketMessageHeader(0, pqSocketMessageHeader::EventMessage),
+                       iter.value().constData(), iter.value().size());
+    this->Statistics.EventsSent++;
+    iter = this->PendingEvents.erase(iter);
+    }
+  if (next >= 0)
+    {
+    this->EventTimer->start(static_cast<int>(next));
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::unsubscribeAll()
+{
+  Subscribers.removeAll(this);
+  this->Subscriptions.clear();
+  this->PendingEvents.clear();
+  this->EventTimes.clear();
+  this->EventTimer->stop();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::executeConfigure(const pqSocketMessageHeader& header,
+                                       const char* payload, int payloadSize)
+{
+  // Every line is applied in order, the reply lists the accepted settings and
+  // names the first rejected one.
+  QStringList accepted;
+  QString exception;
+  QStringList lines = QString::fromUtf8(payload, payloadSize).split('\n', QString::SkipEmptyParts);
+  foreach (QString line, lines)
+    {
+    int separator = line.indexOf('=');
+    QString key = line.left(separator).trimmed();
+    QString value = separator < 0 ? QString() : line.mid(separator + 1).trimmed();
+    if (separator < 0 || !this->configure(key, value))
+      {
+      exception = QString("Invalid setting '%1'.").arg(line.trimmed());
+      break;
+      }
+    accepted.append(QString("%1: %2").arg(pqSocketJSONString(key), pqSocketJSONString(value)));
+    }
+
+  QByteArray reply = QString("{\"result\": {%1}, \"stdout\": \"\", \"stderr\": \"\", "
+                             "\"exception\": %2, \"time\": 0}")
+    .arg(accepted.join(", "), exception.isEmpty() ? QString("null") : pqSocketJSONString(exception))
+    .toUtf8();
+  this->writeMessage(pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHandler::executeStatisticsRequest(const pqSocketMessageHeader& header)
+{
+  QStringList connections;
+  foreach (pqSocketStatistics* statistics, pqSocketStatistics::openConnections())
+    {
+    connections.append(statistics->toJSON());
+    }
+
+  QByteArray reply = QString("{\"result\": {\"connection\": %1, \"connections\": [%2]}, "
+                             "\"stdout\": \"\", \"stderr\": \"\", \"exception\": null, "
+                             "\"time\": 0}")
+    .arg(pqSocketJSONString(this->Statistics.name()), connections.join(", ")).toUtf8();
+  this->writeMessage(pqSocketMessageHeader(header.RequestId, pqSocketMessageHeader::ReplyMessage),
+                     reply.constData(), reply.size());
+}
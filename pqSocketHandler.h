@@ -32,9 +32,35 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _pqSocketHandler_h
 #define _pqSocketHandler_h
 
+#include "pqSocketReceiveBuffer.h"
+#include "pqSocketStatistics.h"
+
+#include <QList>
+#include <QMap>
 #include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+
+class QIODevice;
+class QTimer;
+class pqSocketJournal;
+class pqSocketMessageHeader;
+
+// Chunks of data answering one request, such as the arrays of a fetched
+// dataset, written as DataMessages when the output buffer of the connection
+// has room for them.
+class pqSocketOutputStream
+{
+public:
+
+  virtual ~pqSocketOutputStream() {}
 
-class QTcpSocket;
+  // Points data at the next chunk and sets index to the index of the array
+  // it belongs to.  The data must stay valid until the next call.  Returns
+  // false once everything was sent.
+  virtual bool nextChunk(const char*& data, int& length, int& index) = 0;
+};
 
 class pqSocketHandler : public QObject
 {
@@ -42,20 +68,267 @@ class pqSocketHandler : public QObject
 
 public:
 
-  pqSocketHandler(QObject* parent) : QObject(parent), Socket(NULL) {}
-  virtual ~pqSocketHandler() {}
+  // RawProtocol treats whatever arrives in one read as a message.
+  // FramedProtocol prefixes every message with its length as a 4 byte
+  // big-endian unsigned integer.  RequestProtocol prefixes every message
+  // with a pqSocketMessageHeader and answers each one with a reply.
+  enum ProtocolType
+    {
+    RawProtocol,
+    FramedProtocol,
+    RequestProtocol
+    };
+
+  // Compression of the payloads of the request protocol, negotiated by the
+  // client with a ConfigureMessage.  FastCompression trades ratio for speed.
+  enum CompressionType
+    {
+    NoCompression,
+    ZlibCompression,
+    FastCompression
+    };
+
+  // What happens to a client that does not read its replies fast enough,
+  // once its output buffer goes over the high water mark.  PauseOutput stops
+  // reading and executing its messages until the buffer drains below the low
+  // water mark.  DropFramesOutput skips droppable messages such as images,
+  // replies are always sent.  DisconnectOutput aborts the connection.
+  enum OutputPolicy
+    {
+    PauseOutput,
+    DropFramesOutput,
+    DisconnectOutput
+    };
+
+  pqSocketHandler(QObject* parent);
+  virtual ~pqSocketHandler();
+
+  // Creates a handler of the same type for another connection.
+  virtual pqSocketHandler* newInstance(QObject* parent) = 0;
+
+  // The connection, a QTcpSocket, a QLocalSocket or any other sequential
+  // device.
+  void setSocket(QIODevice* socket);
+  QIODevice* socket() {return this->Socket;}
+
+  void setProtocol(ProtocolType protocol) {this->Protocol = protocol;}
+  ProtocolType protocol() const {return this->Protocol;}
+
+  // Number of bytes preceding each payload in the current protocol.
+  int headerSize() const;
+
+  // Larger messages close the connection.
+  int maximumPayloadSize() const {return this->ReceiveBuffer.maximumPayloadSize();}
+
+  void setCompression(CompressionType compression) {this->Compression = compression;}
+  CompressionType compression() const {return this->Compression;}
+
+  // Payloads smaller than this are sent uncompressed.
+  void setCompressionThreshold(int bytes) {this->CompressionThreshold = bytes;}
+  int compressionThreshold() const {return this->CompressionThreshold;}
+
+  void setOutputPolicy(OutputPolicy policy) {this->Policy = policy;}
+  OutputPolicy outputPolicy() const {return this->Policy;}
+
+  // Limits of the bytes written to the socket but not yet sent.
+  void setOutputWaterMarks(qint64 low, qint64 high);
+  qint64 outputLowWaterMark() const {return this->OutputLowWaterMark;}
+  qint64 outputHighWaterMark() const {return this->OutputHighWaterMark;}
+
+  qint64 outputBuffered() const;
+  bool isOutputBlocked() const {return this->OutputBlocked;}
+
+  virtual void onSocketOpened();
+  virtual void onSocketClosed();
+
+  // Buffers the received bytes.  Messages are not executed until
+  // processNextMessage() is called, which lets the owner of several
+  // connections decide in which order they are served.
+  virtual void onSocketReadReady();
+
+  bool hasPendingMessage() const;
+  int pendingMessageCount() const;
+  qint64 nextMessageArrivalTime() const;
+  int nextMessagePriority() const;
+  void processNextMessage();
+  bool isExecuting() const {return this->Executing;}
+
+  // Called by the scheduler around a run of messages that may come from
+  // several handlers, so that expensive per-message setup such as acquiring
+  // an interpreter is done once.
+  virtual void beginBatch() {}
+  virtual void endBatch() {}
+
+  // While paused, received bytes are left to the socket, whose read buffer
+  // is limited so that TCP flow control pushes back on the client.
+  void setReadingPaused(bool paused);
+  bool isReadingPaused() const {return this->ReadingPaused;}
+
+  // Rejects the given number of most recently received messages instead of
+  // executing them.
+  void discardNewestMessages(int count);
+
+  // Counters and histograms of this connection.
+  pqSocketStatistics& statistics() {return this->Statistics;}
+
+  // Identifies the connection in the journal.
+  quint32 connectionId() const {return this->ConnectionId;}
+
+  // Executes a message read from a journal, without a socket the replies
+  // are dropped.  Unlike a received message it bypasses the receive buffer
+  // and the scheduler, so it neither waits in the queue nor joins a batch.
+  // Returns the execution time in microseconds.
+  qint64 replayMessage(const pqSocketMessageHeader& header,
+                       const char* payload, int payloadSize);
 
-  void setSocket(QTcpSocket* socket) {this->Socket = socket;}
-  QTcpSocket* socket() {return this->Socket;}
+  // Ends the stream answering the given request with an empty DataMessage
+  // flagged as cancelled.  Returns false if there is no such stream.
+  // Subclasses end their own streams, such as a sweep, and pass the others
+  // on.
+  virtual bool cancelStream(quint32 requestId);
+  int pendingStreams() const {return this->Streams.size();}
 
-  virtual void onSocketOpened() {}
-  virtual void onSocketClosed() {}
-  virtual void onSocketReadReady() {}
+  // Interrupts a request while it executes, with the function registered by
+  // the handlers that can interrupt their scripts.  The function is set once
+  // and must be safe to call from any thread, such as the network thread
+  // that sees the CancelMessage first.  Returns false if the request is not
+  // executing.
+  typedef bool (*InterruptFunction)(quint32 connectionId, quint32 requestId);
+  static void setInterruptFunction(InterruptFunction function);
+  static bool interruptRequest(quint32 connectionId, quint32 requestId);
+
+  // Events that clients of the request protocol can subscribe to, registered
+  // by whoever publishes them.
+  static void registerEvent(const QString& name);
+  static QStringList eventNames();
+  static bool hasSubscribers(const QString& name);
+
+  // Pushes an EventMessage with the JSON payload to every connection
+  // subscribed to the event.  Within a connection's event interval, events
+  // with the same name and key replace each other and only the last one is
+  // sent once the interval has passed.
+  static void publishEvent(const QString& name, const QString& key, const QByteArray& payload);
+
+  // While set, every message executed by any handler is appended to the
+  // journal.  The journal is not owned.
+  static void setJournal(pqSocketJournal* journal);
+  static pqSocketJournal* journal();
+
+  // Monotonic time in microseconds used to stamp messages.
+  static qint64 currentTime();
+
+signals:
+
+  // Emitted when a blocked connection drained its output buffer, its queued
+  // messages can be executed again.
+  void outputDrained();
+
+  // Emitted when a connection stops holding its queued messages.
+  void messagesReleased();
+
+protected slots:
+
+  void onBytesWritten();
+  void sendPendingEvents();
 
 protected:
 
-  QTcpSocket* Socket;
+  // Called with one complete message.  The payload is only valid for the
+  // duration of the call.
+  virtual void executeMessage(const pqSocketMessageHeader& header,
+                              const char* payload, int payloadSize) = 0;
+
+  // Called instead of executeMessage() for a discarded message.
+  virtual void rejectMessage(const pqSocketMessageHeader& header);
+
+  // Applies one key=value line of a ConfigureMessage.  Returns false for an
+  // unknown key or an invalid value.  Subclasses handle their own keys and
+  // pass the others on.
+  virtual bool configure(const QString& key, const QString& value);
+
+  void executeConfigure(const pqSocketMessageHeader& header,
+                        const char* payload, int payloadSize);
+
+  // Executes a message that was read and uncompressed.
+  void dispatchMessage(const pqSocketMessageHeader& header,
+                       const char* payload, int payloadSize);
+
+  // Answers a FetchMessage.  Returns the stream of its chunks and sets the
+  // JSON result of the reply that precedes them, or returns NULL and sets
+  // error.  The default does not support fetching.
+  virtual pqSocketOutputStream* createStream(const pqSocketMessageHeader& header,
+                                             const char* payload, int payloadSize,
+                                             QString& result, QString& error);
+
+  void executeFetch(const pqSocketMessageHeader& header,
+                    const char* payload, int payloadSize);
+
+  // Writes chunks of the pending streams, oldest first, until the output
+  // buffer reaches its low water mark.
+  void pumpStreams();
+
+  // Answers a StatisticsMessage with the statistics of all open connections.
+  void executeStatisticsRequest(const pqSocketMessageHeader& header);
+
+  // Writes a message framed according to the current protocol.  The header
+  // is only used by the request protocol, its payload size is filled in.
+  // A droppable message may be skipped when the client falls behind.
+  // Returns false if nothing was written.
+  bool writeMessage(const pqSocketMessageHeader& header, const char* data, int length,
+                    bool droppable=false);
+
+  // While held, queued messages are not executed, for a request whose
+  // answer spans several turns of the event loop.  Cancels are still seen.
+  void holdMessages(bool hold);
+  bool isHoldingMessages() const {return this->HoldingMessages;}
+
+  // Answers a request with a reply whose exception is the given message.
+  // Does nothing outside the request protocol.
+  void writeErrorReply(const pqSocketMessageHeader& request, const QString& message);
+
+  QIODevice* Socket;
+  ProtocolType Protocol;
+  pqSocketReceiveBuffer ReceiveBuffer;
+  bool Executing;
+  bool HoldingMessages;
+  bool ReadingPaused;
+  bool OutputBlocked;
+  OutputPolicy Policy;
+  qint64 OutputLowWaterMark;
+  qint64 OutputHighWaterMark;
+  CompressionType Compression;
+  int CompressionThreshold;
+  QByteArray UncompressedPayload;
+  pqSocketStatistics Statistics;
+  quint32 ConnectionId;
+
+  // Subscribed events, the minimum time in milliseconds between two events
+  // with the same name and key, when each was last sent and the ones held
+  // back by that interval.
+  QSet<QString> Subscriptions;
+  int EventInterval;
+  QMap<QString, qint64> EventTimes;
+  QMap<QString, QByteArray> PendingEvents;
+  QTimer* EventTimer;
+
+  // Streams answering fetches, with their request ids.
+  QList<QPair<quint32, pqSocketOutputStream*> > Streams;
+
+  // Queued requests dropped by a cancel, answered when they are popped.
+  QSet<quint32> CancelledRequests;
+
+private:
+
+  // Cancels a request: ends its stream, drops it if it is among the given
+  // number of oldest queued messages or interrupts it.
+  bool cancelRequest(quint32 requestId, int queuedMessages);
+
+  void pushEvent(const QString& name, const QString& key, const QByteArray& payload);
+  void unsubscribeAll();
+  void deleteStreams();
+
+  void updateReadBuffer();
+  void updateOutputBuffered();
 };
 
 #endif
-
@@ -0,0 +1,560 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketIOThread.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#include "pqSocketIOThread.h"
+#include "pqSocketHandler.h"
+#include "pqSocketMessage.h"
+
+#include <QAbstractSocket>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QtEndian>
+
+#include <limits.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+pqSocketIOWorker::pqSocketIOWorker(int headerSize, int maximumPayloadSize, int inboundLimit,
+                                   quint32 connectionId)
+  : Inbound(16384), Outbound(4096)
+{
+  this->Socket = 0;
+  this->ConnectionId = connectionId;
+  this->ScannedFrames = 0;
+  this->InboundLimit = inboundLimit;
+  this->ReceiveBuffer.setHeaderSize(headerSize);
+  this->ReceiveBuffer.setMaximumPayloadSize(maximumPayloadSize);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOWorker::~pqSocketIOWorker()
+{
+  delete this->Socket;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::setSocket(QIODevice* socket)
+{
+  this->Socket = socket;
+  this->connect(this->Socket, SIGNAL(readyRead()), SLOT(readFrames()));
+  this->connect(this->Socket, SIGNAL(bytesWritten(qint64)), SLOT(onBytesWritten(qint64)));
+  this->connect(this->Socket, SIGNAL(disconnected()), SIGNAL(disconnected()));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::openDescriptor(quintptr descriptor, bool local)
+{
+  bool opened;
+  if (local)
+    {
+    QLocalSocket* socket = new QLocalSocket(this);
+    this->setSocket(socket);
+    opened = socket->setSocketDescriptor(descriptor);
+    }
+  else
+    {
+    QTcpSocket* socket = new QTcpSocket(this);
+    this->setSocket(socket);
+    opened = socket->setSocketDescriptor(static_cast<int>(descriptor));
+    }
+
+  if (!opened)
+    {
+    emit this->error(this->Socket->errorString());
+    emit this->disconnected();
+    return;
+    }
+  this->onConnected();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::connectToHost(const QString& host, int port)
+{
+  QTcpSocket* socket = new QTcpSocket(this);
+  this->setSocket(socket);
+  this->connect(socket, SIGNAL(connected()), SLOT(onConnected()));
+  this->connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), SLOT(onError()));
+  socket->connectToHost(host, port);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::connectToServer(const QString& name)
+{
+  QLocalSocket* socket = new QLocalSocket(this);
+  this->setSocket(socket);
+  this->connect(socket, SIGNAL(connected()), SLOT(onConnected()));
+  this->connect(socket, SIGNAL(error(QLocalSocket::LocalSocketError)), SLOT(onError()));
+  socket->connectToServer(name);
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketIOWorker::peerName() const
+{
+  if (QTcpSocket* socket = qobject_cast<QTcpSocket*>(this->Socket))
+    {
+    return QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+    }
+  return QString();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::onConnected()
+{
+  emit this->connected(this->peerName());
+
+  // Writes queued while connecting, and bytes that arrived with the
+  // connection, do not signal on their own.
+  this->writeQueued();
+  this->readFrames();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::onError()
+{
+  emit this->error(this->Socket->errorString());
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::readFrames()
+{
+  if (!this->Socket)
+    {
+    return;
+    }
+
+  // With the ring full the bytes are still read, up to the scan limit, to
+  // find cancels; past it they are left to the socket.
+  if (!this->pushFrames() && this->ReceiveBuffer.bytesBuffered() >= ScanLimit)
+    {
+    return;
+    }
+
+  if (!this->ReceiveBuffer.readFrom(this->Socket))
+    {
+    qCritical("Closing remote control socket: received a message larger than %d bytes.",
+              this->ReceiveBuffer.maximumPayloadSize());
+    this->abort();
+    return;
+    }
+  this->scanFrames();
+  this->pushFrames();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::scanFrames()
+{
+  if (this->ReceiveBuffer.headerSize() != pqSocketMessageHeader::Size)
+    {
+    return;
+    }
+  for (; this->ScannedFrames < this->ReceiveBuffer.frameCount(); ++this->ScannedFrames)
+    {
+    pqSocketMessageHeader header;
+    header.decode(this->ReceiveBuffer.frameHeader(this->ScannedFrames));
+    if (header.Type == pqSocketMessageHeader::CancelMessage)
+      {
+      pqSocketHandler::interruptRequest(this->ConnectionId, header.RequestId);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketIOWorker::pushFrame(const pqSocketIOFrame& frame)
+{
+  // The slots of the ring are plenty, the bytes are what is limited.
+  int queued = this->InboundBytes.fetchAndAddAcquire(0);
+  if (queued > 0 && static_cast<qint64>(queued) + frame.Data.size() > this->InboundLimit)
+    {
+    return false;
+    }
+  return this->Inbound.push(frame);
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketIOWorker::pushFrames()
+{
+  bool pushed = false;
+  while (!this->Pending.Data.isNull() || this->ReceiveBuffer.hasFrame())
+    {
+    if (this->Pending.Data.isNull())
+      {
+      this->Pending = this->takeFrame();
+      }
+
+    int size = this->Pending.Data.size();
+    if (!this->pushFrame(this->Pending))
+      {
+      // The GUI thread is behind.  Leaving the bytes to the socket, with a
+      // limited read buffer, lets TCP flow control push back on the client.
+      // The push is retried once after raising the flag in case the ring was
+      // emptied in between.
+      this->ReadBlocked.fetchAndStoreOrdered(1);
+      if (!this->pushFrame(this->Pending))
+        {
+        this->setReadBufferSize(64*1024);
+        break;
+        }
+      this->ReadBlocked.fetchAndStoreOrdered(0);
+      }
+    this->InboundBytes.fetchAndAddOrdered(size);
+    this->Pending = pqSocketIOFrame();
+    pushed = true;
+    }
+
+  if (pushed && this->ReadNotified.testAndSetOrdered(0, 1))
+    {
+    emit this->framesAvailable();
+    }
+  if (this->Pending.Data.isNull())
+    {
+    this->setReadBufferSize(0);
+    return true;
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOFrame pqSocketIOWorker::takeFrame()
+{
+  pqSocketIOFrame frame;
+  int headerSize = this->ReceiveBuffer.headerSize();
+  const char* payload = this->ReceiveBuffer.payload();
+  int payloadSize = this->ReceiveBuffer.payloadSize();
+
+  pqSocketMessageHeader header;
+  if (headerSize == pqSocketMessageHeader::Size)
+    {
+    header.decode(this->ReceiveBuffer.header());
+    }
+  this->ScannedFrames = qMax(0, this->ScannedFrames - 1);
+
+  // Compressed requests are uncompressed here once the connection negotiated
+  // compression.  Anything that fails the checks is passed on unchanged and
+  // answered with an error by the handler.
+  if (headerSize == pqSocketMessageHeader::Size && this->Decompress.fetchAndAddAcquire(0))
+    {
+    quint32 size = payloadSize >= 4
+      ? qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(payload)) : 0;
+    if ((header.Flags & pqSocketMessageHeader::CompressedFlag)
+        && size <= static_cast<quint32>(this->ReceiveBuffer.maximumPayloadSize()))
+      {
+      QElapsedTimer timer;
+      timer.start();
+      QByteArray uncompressed = qUncompress(reinterpret_cast<const uchar*>(payload), payloadSize);
+      if (uncompressed.size() == static_cast<int>(size))
+        {
+        header.Flags &= ~pqSocketMessageHeader::CompressedFlag;
+        header.PayloadSize = size;
+        frame.Data.resize(headerSize + uncompressed.size());
+        header.encode(frame.Data.data());
+        memcpy(frame.Data.data() + headerSize, uncompressed.constData(), uncompressed.size());
+        frame.CompressedSize = payloadSize;
+        frame.CompressionTime = timer.nsecsElapsed() / 1000;
+        this->ReceiveBuffer.popFrame();
+        return frame;
+        }
+      }
+    }
+
+  frame.Data.resize(headerSize + payloadSize);
+  memcpy(frame.Data.data(), this->ReceiveBuffer.header(), headerSize);
+  memcpy(frame.Data.data() + headerSize, payload, payloadSize);
+  this->ReceiveBuffer.popFrame();
+  return frame;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::setReadBufferSize(qint64 size)
+{
+  if (QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(this->Socket))
+    {
+    socket->setReadBufferSize(size);
+    }
+  else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(this->Socket))
+    {
+    socket->setReadBufferSize(size);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::writeQueued()
+{
+  this->WriteRequested.fetchAndStoreOrdered(0);
+
+  // Bytes written before the socket is open wait in the ring.
+  if (!this->Socket || !this->Socket->isOpen())
+    {
+    return;
+    }
+
+  QByteArray data;
+  while (this->Outbound.pop(data))
+    {
+    this->Socket->write(data);
+    this->SocketBytes.fetchAndStoreOrdered(static_cast<int>(this->Socket->bytesToWrite()));
+    this->QueuedBytes.fetchAndAddOrdered(-data.size());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::onBytesWritten(qint64 bytes)
+{
+  this->SocketBytes.fetchAndStoreOrdered(static_cast<int>(this->Socket->bytesToWrite()));
+  emit this->bytesWritten(bytes);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::close()
+{
+  if (this->Socket)
+    {
+    this->writeQueued();
+    this->Socket->close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOWorker::abort()
+{
+  if (QAbstractSocket* socket = qobject_cast<QAbstractSocket*>(this->Socket))
+    {
+    socket->abort();
+    }
+  else if (QLocalSocket* socket = qobject_cast<QLocalSocket*>(this->Socket))
+    {
+    socket->abort();
+    }
+  else if (this->Socket)
+    {
+    this->Socket->close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOChannel::pqSocketIOChannel(pqSocketIOWorker* worker, QObject* parent)
+  : QIODevice(parent)
+{
+  this->Worker = worker;
+  this->connect(this->Worker, SIGNAL(connected(const QString&)),
+                SLOT(onConnected(const QString&)));
+  this->connect(this->Worker, SIGNAL(error(const QString&)), SLOT(onError(const QString&)));
+  this->connect(this->Worker, SIGNAL(framesAvailable()), SLOT(onFramesAvailable()));
+  this->connect(this->Worker, SIGNAL(bytesWritten(qint64)), SLOT(onBytesWritten(qint64)));
+  this->connect(this->Worker, SIGNAL(disconnected()), SIGNAL(disconnected()));
+  this->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOChannel::~pqSocketIOChannel()
+{
+  this->Worker->deleteLater();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::openDescriptor(quintptr descriptor, bool local)
+{
+  QMetaObject::invokeMethod(this->Worker, "openDescriptor", Qt::QueuedConnection,
+                            Q_ARG(quintptr, descriptor), Q_ARG(bool, local));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::connectToHost(const QString& host, int port)
+{
+  QMetaObject::invokeMethod(this->Worker, "connectToHost", Qt::QueuedConnection,
+                            Q_ARG(QString, host), Q_ARG(int, port));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::connectToServer(const QString& name)
+{
+  QMetaObject::invokeMethod(this->Worker, "connectToServer", Qt::QueuedConnection,
+                            Q_ARG(QString, name));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::onConnected(const QString& peerName)
+{
+  this->PeerName = peerName;
+  emit this->connected();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::onError(const QString& message)
+{
+  this->setErrorString(message);
+  emit this->error();
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketIOChannel::bytesAvailable() const
+{
+  return this->Worker->InboundBytes.fetchAndAddAcquire(0);
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketIOChannel::bytesToWrite() const
+{
+  return this->Worker->QueuedBytes.fetchAndAddAcquire(0)
+    + this->Worker->SocketBytes.fetchAndAddAcquire(0);
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketIOChannel::takeFrame(pqSocketIOFrame& frame)
+{
+  if (!this->Worker->Inbound.pop(frame))
+    {
+    return false;
+    }
+  this->Worker->InboundBytes.fetchAndAddOrdered(-frame.Data.size());
+
+  // There is room in the ring again.
+  if (this->Worker->ReadBlocked.testAndSetOrdered(1, 0))
+    {
+    QMetaObject::invokeMethod(this->Worker, "readFrames", Qt::QueuedConnection);
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketIOChannel::readData(char*, qint64)
+{
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketIOChannel::writeData(const char* data, qint64 size)
+{
+  QByteArray bytes(data, static_cast<int>(size));
+  this->Worker->QueuedBytes.fetchAndAddOrdered(bytes.size());
+
+  // Once something overflowed, later bytes queue behind it to keep the order.
+  if (!this->Overflow.isEmpty() || !this->Worker->Outbound.push(bytes))
+    {
+    this->Overflow.enqueue(bytes);
+    }
+  this->requestWrite();
+  return size;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::requestWrite()
+{
+  if (this->Worker->WriteRequested.testAndSetOrdered(0, 1))
+    {
+    QMetaObject::invokeMethod(this->Worker, "writeQueued", Qt::QueuedConnection);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::close()
+{
+  if (!this->isOpen())
+    {
+    return;
+    }
+  QIODevice::close();
+  QMetaObject::invokeMethod(this->Worker, "close", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::abort()
+{
+  QIODevice::close();
+  QMetaObject::invokeMethod(this->Worker, "abort", Qt::QueuedConnection);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::setDecompressing(bool decompress)
+{
+  this->Worker->Decompress.fetchAndStoreRelease(decompress ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::onFramesAvailable()
+{
+  this->Worker->ReadNotified.fetchAndStoreOrdered(0);
+  emit this->readyRead();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOChannel::onBytesWritten(qint64 bytes)
+{
+  bool moved = false;
+  while (!this->Overflow.isEmpty() && this->Worker->Outbound.push(this->Overflow.head()))
+    {
+    this->Overflow.dequeue();
+    moved = true;
+    }
+  if (moved)
+    {
+    this->requestWrite();
+    }
+  emit this->bytesWritten(bytes);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOThread::pqSocketIOThread(QObject* parent) : QThread(parent)
+{
+  // For the descriptors passed to the workers.
+  qRegisterMetaType<quintptr>("quintptr");
+  this->start();
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOThread::~pqSocketIOThread()
+{
+  this->quit();
+  this->wait();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketIOThread::run()
+{
+  this->exec();
+
+  // Workers of channels destroyed just before the thread stopped.
+  QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketIOChannel* pqSocketIOThread::newChannel(int headerSize, int maximumPayloadSize,
+                                                qint64 inboundLimit, quint32 connectionId)
+{
+  // The worker has no socket yet, the framing is set before anything is read.
+  pqSocketIOWorker* worker = new pqSocketIOWorker(
+    headerSize, maximumPayloadSize, static_cast<int>(qBound<qint64>(1, inboundLimit, INT_MAX)),
+    connectionId);
+  worker->moveToThread(this);
+  return new pqSocketIOChannel(worker);
+}
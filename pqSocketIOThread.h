@@ -0,0 +1,329 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketIOThread.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketIOThread_h
+#define _pqSocketIOThread_h
+
+#include "pqSocketReceiveBuffer.h"
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QIODevice>
+#include <QLocalServer>
+#include <QQueue>
+#include <QTcpServer>
+#include <QThread>
+
+// Bounded queue between exactly one producer thread and one consumer
+// thread.  Neither side takes a lock: each only writes its own index and
+// publishes it with release semantics after the slot it covers.
+template <class T>
+class pqSocketRing
+{
+public:
+
+  pqSocketRing(int capacity) : Size(capacity + 1), Head(0), Tail(0)
+    {
+    this->Items = new T[this->Size];
+    }
+
+  ~pqSocketRing()
+    {
+    delete [] this->Items;
+    }
+
+  // Producer side, returns false when the ring is full.
+  bool push(const T& item)
+    {
+    int tail = this->Tail;
+    int next = (tail + 1) % this->Size;
+    if (next == this->Head.fetchAndAddAcquire(0))
+      {
+      return false;
+      }
+    this->Items[tail] = item;
+    this->Tail.fetchAndStoreRelease(next);
+    return true;
+    }
+
+  // Consumer side, returns false when the ring is empty.
+  bool pop(T& item)
+    {
+    int head = this->Head;
+    if (head == this->Tail.fetchAndAddAcquire(0))
+      {
+      return false;
+      }
+    item = this->Items[head];
+    this->Items[head] = T();
+    this->Head.fetchAndStoreRelease((head + 1) % this->Size);
+    return true;
+    }
+
+private:
+
+  pqSocketRing(const pqSocketRing&);
+  void operator=(const pqSocketRing&);
+
+  T* Items;
+  int Size;
+  QAtomicInt Head;
+  QAtomicInt Tail;
+};
+
+// A complete frame, header included, handed from the network thread to the
+// GUI thread.  When the network thread uncompressed the payload,
+// CompressedSize is its size as received and CompressionTime the
+// microseconds that took.
+struct pqSocketIOFrame
+{
+  pqSocketIOFrame() : CompressedSize(0), CompressionTime(0) {}
+
+  QByteArray Data;
+  int CompressedSize;
+  qint64 CompressionTime;
+};
+
+// Owns a socket in the network thread.  The socket is created there, from
+// the descriptor of an accepted connection or by connecting, so it never
+// changes threads.  Incoming bytes are framed, and
+// compressed payloads uncompressed, before the complete frames are handed
+// to the GUI thread through the inbound ring.  Bytes written by the GUI
+// thread arrive through the outbound ring.  The atomics are shared with
+// the pqSocketIOChannel on the GUI side.
+//
+// A frame is copied once, from the worker's receive buffer into its own
+// QByteArray, which the handler then queues as it is.  The inbound ring is
+// limited by bytes, a single frame of any size passes when it is empty.
+// While the ring is full the worker keeps reading up to ScanLimit bytes, so
+// that a cancel queued behind them still interrupts the request that holds
+// up the GUI thread.
+class pqSocketIOWorker : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketIOWorker(int headerSize, int maximumPayloadSize, int inboundLimit,
+                   quint32 connectionId);
+  virtual ~pqSocketIOWorker();
+
+  pqSocketRing<pqSocketIOFrame> Inbound;
+  pqSocketRing<QByteArray> Outbound;
+
+  // Bytes waiting in the inbound ring, in the outbound ring and in the
+  // socket's write buffer.
+  QAtomicInt InboundBytes;
+  QAtomicInt QueuedBytes;
+  QAtomicInt SocketBytes;
+
+  // Set while a notification is on its way, so that a burst of frames or
+  // writes costs one queued event.
+  QAtomicInt ReadNotified;
+  QAtomicInt WriteRequested;
+
+  // Set while the inbound ring is full, the GUI thread wakes the worker
+  // once it made room.
+  QAtomicInt ReadBlocked;
+
+  QAtomicInt Decompress;
+
+signals:
+
+  void connected(const QString& peerName);
+  void error(const QString& message);
+  void framesAvailable();
+  void bytesWritten(qint64 bytes);
+  void disconnected();
+
+public slots:
+
+  void openDescriptor(quintptr descriptor, bool local);
+  void connectToHost(const QString& host, int port);
+  void connectToServer(const QString& name);
+  void readFrames();
+  void writeQueued();
+  void close();
+  void abort();
+
+protected slots:
+
+  void onConnected();
+  void onError();
+  void onBytesWritten(qint64 bytes);
+
+private:
+
+  enum
+    {
+    ScanLimit = 4*1024*1024
+    };
+
+  void setSocket(QIODevice* socket);
+  QString peerName() const;
+  bool pushFrame(const pqSocketIOFrame& frame);
+  bool pushFrames();
+  void scanFrames();
+  pqSocketIOFrame takeFrame();
+  void setReadBufferSize(qint64 size);
+
+  QIODevice* Socket;
+  pqSocketReceiveBuffer ReceiveBuffer;
+  pqSocketIOFrame Pending;
+  int ScannedFrames;
+  int InboundLimit;
+  quint32 ConnectionId;
+};
+
+// The GUI thread side of a socket owned by a pqSocketIOWorker.  It is a
+// sequential device like the socket itself: writing queues the bytes for
+// the network thread, and bytesToWrite() counts the bytes queued or
+// buffered there.  Incoming frames are taken whole with takeFrame(),
+// reading the device returns nothing.
+class pqSocketIOChannel : public QIODevice
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketIOChannel(pqSocketIOWorker* worker, QObject* parent=0);
+  virtual ~pqSocketIOChannel();
+
+  // Creates the socket in the network thread, connected() or error()
+  // follows.  An accepted connection is opened from its descriptor.
+  void openDescriptor(quintptr descriptor, bool local);
+  void connectToHost(const QString& host, int port);
+  void connectToServer(const QString& name);
+
+  // Address and port of a TCP peer once connected.
+  QString peerName() const {return this->PeerName;}
+
+  virtual bool isSequential() const {return true;}
+  virtual qint64 bytesAvailable() const;
+  virtual qint64 bytesToWrite() const;
+
+  // Closes the socket after the queued bytes are sent, abort() drops them.
+  virtual void close();
+  void abort();
+
+  // Takes the next complete frame, header included, off the inbound ring.
+  bool takeFrame(pqSocketIOFrame& frame);
+
+  // Lets the network thread uncompress payloads flagged as compressed.
+  void setDecompressing(bool decompress);
+
+signals:
+
+  void connected();
+  void error();
+  void disconnected();
+
+protected:
+
+  virtual qint64 readData(char* data, qint64 maxSize);
+  virtual qint64 writeData(const char* data, qint64 size);
+
+protected slots:
+
+  void onConnected(const QString& peerName);
+  void onError(const QString& message);
+  void onFramesAvailable();
+  void onBytesWritten(qint64 bytes);
+
+private:
+
+  void requestWrite();
+
+  pqSocketIOWorker* Worker;
+  QString PeerName;
+  QQueue<QByteArray> Overflow;
+};
+
+// Thread running the workers of all connections that use it.
+class pqSocketIOThread : public QThread
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketIOThread(QObject* parent);
+  virtual ~pqSocketIOThread();
+
+  // Returns the channel of a new connection, whose socket is then opened
+  // through it.  The socket is deleted with the channel.  At most
+  // inboundLimit bytes of frames wait for the GUI thread.  A CancelMessage
+  // interrupts the request of the given connection from this thread, since
+  // the GUI thread may be busy executing it.
+  pqSocketIOChannel* newChannel(int headerSize, int maximumPayloadSize, qint64 inboundLimit,
+                                quint32 connectionId);
+
+protected:
+
+  virtual void run();
+};
+
+// Servers whose accepted connections go to a pqSocketIOThread: they pass the
+// socket descriptor on instead of creating a socket in the GUI thread.
+class pqSocketIOTcpServer : public QTcpServer
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketIOTcpServer(QObject* parent) : QTcpServer(parent) {}
+
+signals:
+
+  void newDescriptor(quintptr descriptor);
+
+protected:
+
+  virtual void incomingConnection(int descriptor) {emit this->newDescriptor(descriptor);}
+};
+
+class pqSocketIOLocalServer : public QLocalServer
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketIOLocalServer(QObject* parent) : QLocalServer(parent) {}
+
+signals:
+
+  void newDescriptor(quintptr descriptor);
+
+protected:
+
+  virtual void incomingConnection(quintptr descriptor) {emit this->newDescriptor(descriptor);}
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketImageEncoder.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketImageEncoder.h"
+
+#include <vtkImageData.h>
+#include <vtkJPEGWriter.h>
+#include <vtkPNGWriter.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <QPoint>
+#include <QVector>
+#include <QtEndian>
+
+#include <string.h>
+
+namespace
+{
+  template <class Writer>
+  QByteArray writeToMemory(Writer* writer, vtkImageData* image)
+    {
+    writer->SetInput(image);
+    writer->WriteToMemoryOn();
+    writer->Write();
+    vtkUnsignedCharArray* result = writer->GetResult();
+    if (!result)
+      {
+      return QByteArray();
+      }
+    return QByteArray(reinterpret_cast<const char*>(result->GetPointer(0)),
+                      result->GetNumberOfTuples()*result->GetNumberOfComponents());
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketImageEncoder::pqSocketImageEncoder()
+{
+  this->Width = 0;
+  this->Height = 0;
+  this->Components = 0;
+  this->TileSize = 64;
+  this->JPEGQuality = 90;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketImageEncoder::reset()
+{
+  this->Previous.clear();
+}
+
+//-----------------------------------------------------------------------------
+QByteArray pqSocketImageEncoder::encode(vtkImageData* image, Codec codec, bool delta)
+{
+  if (!image || image->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+    return QByteArray();
+    }
+
+  // Tile positions and sizes are 16 bit fields.
+  int dimensions[3];
+  image->GetDimensions(dimensions);
+  if (dimensions[0] > 0xFFFF || dimensions[1] > 0xFFFF)
+    {
+    return QByteArray();
+    }
+  int inputComponents = image->GetNumberOfScalarComponents();
+  int components = inputComponents >= 3 ? 3 : inputComponents;
+  if (dimensions[0] != this->Width || dimensions[1] != this->Height
+      || components != this->Components)
+    {
+    this->Previous.clear();
+    }
+  this->Width = dimensions[0];
+  this->Height = dimensions[1];
+  this->Components = components;
+
+  // Keep a packed, top-down copy of the frame.  It is what the tiles are cut
+  // from and what the next frame is compared against.
+  int rowSize = this->Width*components;
+  this->Pixels.resize(rowSize*this->Height);
+  const unsigned char* source = static_cast<unsigned char*>(image->GetScalarPointer());
+  for (int row = 0; row < this->Height; ++row)
+    {
+    const unsigned char* in = source + (this->Height - row - 1)*this->Width*inputComponents;
+    char* out = this->Pixels.data() + row*rowSize;
+    if (components == inputComponents)
+      {
+      memcpy(out, in, rowSize);
+      continue;
+      }
+    for (int i = 0; i < this->Width; ++i)
+      {
+      memcpy(out + i*components, in + i*inputComponents, components);
+      }
+    }
+
+  // A delta with more changed tiles than the tile count field holds is
+  // sent as a full frame instead.
+  QVector<QPoint> changed;
+  if (delta && !this->Previous.isEmpty())
+    {
+    for (int y = 0; y < this->Height && changed.size() <= 0xFFFF; y += this->TileSize)
+      {
+      for (int x = 0; x < this->Width && changed.size() <= 0xFFFF; x += this->TileSize)
+        {
+        if (this->tileChanged(x, y, qMin(this->TileSize, this->Width - x),
+                              qMin(this->TileSize, this->Height - y)))
+          {
+          changed.append(QPoint(x, y));
+          }
+        }
+      }
+    }
+
+  QByteArray tiles;
+  int tileCount = 0;
+  if (!delta || this->Previous.isEmpty() || changed.size() > 0xFFFF)
+    {
+    tiles = this->encodeTile(0, 0, this->Width, this->Height, codec);
+    tileCount = 1;
+    }
+  else
+    {
+    foreach (const QPoint& tile, changed)
+      {
+      tiles.append(this->encodeTile(tile.x(), tile.y(),
+                                    qMin(this->TileSize, this->Width - tile.x()),
+                                    qMin(this->TileSize, this->Height - tile.y()), codec));
+      }
+    tileCount = changed.size();
+    }
+  this->Previous.swap(this->Pixels);
+
+  QByteArray result(12, 0);
+  uchar* header = reinterpret_cast<uchar*>(result.data());
+  header[0] = static_cast<uchar>(codec);
+  header[1] = static_cast<uchar>(components);
+  qToBigEndian<quint16>(tileCount, header + 2);
+  qToBigEndian<quint32>(this->Width, header + 4);
+  qToBigEndian<quint32>(this->Height, header + 8);
+  result.append(tiles);
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketImageEncoder::tileChanged(int x, int y, int width, int height) const
+{
+  int rowSize = this->Width*this->Components;
+  int offset = y*rowSize + x*this->Components;
+  for (int row = 0; row < height; ++row, offset += rowSize)
+    {
+    if (memcmp(this->Pixels.constData() + offset, this->Previous.constData() + offset,
+               width*this->Components))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+QByteArray pqSocketImageEncoder::encodeTile(int x, int y, int width, int height,
+                                            Codec codec) const
+{
+  int rowSize = this->Width*this->Components;
+  int tileRowSize = width*this->Components;
+  const char* source = this->Pixels.constData() + y*rowSize + x*this->Components;
+
+  QByteArray data;
+  if (codec == RawCodec)
+    {
+    QByteArray tile(tileRowSize*height, 0);
+    for (int row = 0; row < height; ++row)
+      {
+      memcpy(tile.data() + row*tileRowSize, source + row*rowSize, tileRowSize);
+      }
+    data = qCompress(tile, 1);
+    }
+  else
+    {
+    // The image writers expect the bottom row first.
+    vtkSmartPointer<vtkUnsignedCharArray> scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    scalars->SetNumberOfComponents(this->Components);
+    scalars->SetNumberOfTuples(width*height);
+    unsigned char* out = scalars->GetPointer(0);
+    for (int row = 0; row < height; ++row)
+      {
+      memcpy(out + (height - row - 1)*tileRowSize, source + row*rowSize, tileRowSize);
+      }
+
+    vtkSmartPointer<vtkImageData> tile = vtkSmartPointer<vtkImageData>::New();
+    tile->SetDimensions(width, height, 1);
+    tile->SetScalarTypeToUnsignedChar();
+    tile->SetNumberOfScalarComponents(this->Components);
+    tile->GetPointData()->SetScalars(scalars);
+
+    if (codec == JPEGCodec)
+      {
+      vtkSmartPointer<vtkJPEGWriter> writer = vtkSmartPointer<vtkJPEGWriter>::New();
+      writer->SetQuality(this->JPEGQuality);
+      data = writeToMemory(writer.GetPointer(), tile);
+      }
+    else
+      {
+      data = writeToMemory(vtkSmartPointer<vtkPNGWriter>::New().GetPointer(), tile);
+      }
+    }
+
+  QByteArray result(12, 0);
+  uchar* header = reinterpret_cast<uchar*>(result.data());
+  qToBigEndian<quint16>(x, header);
+  qToBigEndian<quint16>(y, header + 2);
+  qToBigEndian<quint16>(width, header + 4);
+  qToBigEndian<quint16>(height, header + 6);
+  qToBigEndian<quint32>(data.size(), header + 8);
+  result.append(data);
+  return result;
+}
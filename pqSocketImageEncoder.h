@@ -0,0 +1,96 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketImageEncoder.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketImageEncoder_h
+#define _pqSocketImageEncoder_h
+
+#include <QByteArray>
+
+class vtkImageData;
+
+// Encodes rendered images for an ImageMessage.  The payload starts with
+// big-endian fields describing the frame followed by a list of tiles:
+//
+//   quint8  codec
+//   quint8  components per pixel
+//   quint16 tile count
+//   quint32 width
+//   quint32 height
+//
+// and for every tile:
+//
+//   quint16 x, y, width, height in pixels, y counted from the top row
+//   quint32 size of the encoded tile in bytes
+//   char[]  the tile encoded with the codec
+//
+// A full frame is a single tile covering the image.  In delta mode only the
+// tiles that differ from the previously encoded frame are included, unless
+// there are more than 65535 of them.  Images wider or taller than 65535
+// pixels are not encoded.
+class pqSocketImageEncoder
+{
+public:
+
+  enum Codec
+    {
+    PNGCodec = 0,
+    JPEGCodec = 1,
+    RawCodec = 2
+    };
+
+  pqSocketImageEncoder();
+
+  void setTileSize(int size) {this->TileSize = size;}
+  int tileSize() const {return this->TileSize;}
+
+  void setJPEGQuality(int quality) {this->JPEGQuality = quality;}
+  int jpegQuality() const {return this->JPEGQuality;}
+
+  QByteArray encode(vtkImageData* image, Codec codec, bool delta);
+
+  // Forgets the previous frame, the next encode() sends a full frame.
+  void reset();
+
+protected:
+
+  QByteArray encodeTile(int x, int y, int width, int height, Codec codec) const;
+  bool tileChanged(int x, int y, int width, int height) const;
+
+  QByteArray Pixels;
+  QByteArray Previous;
+  int Width;
+  int Height;
+  int Components;
+  int TileSize;
+  int JPEGQuality;
+};
+
+#endif
@@ -31,39 +31,59 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 =========================================================================*/
 
 #include "pqSocketItem.h"
+#include "pqSocketEndpoint.h"
 #include "pqSocketHandler.h"
 
+#include <QCheckBox>
 #include <QComboBox>
-#include <QDebug>
 #include <QGridLayout>
 #include <QLineEdit>
-#include <QMessageBox>
+#include <QList>
 #include <QPushButton>
-#include <QTcpServer>
-#include <QTcpSocket>
-
+#include <QSpinBox>
 
 //-----------------------------------------------------------------------------
 class pqSocketItem::pqInternal
 {
 public:
 
-  pqInternal()
+  // The type combo lists the TCP client and server followed by the local
+  // client and server, like pqSocketEndpoint::SocketType, and the local
+  // types use the port field as the socket name.
+  bool isClient() const
+    {
+    return this->TypeCombo->currentIndex() % 2 == 0;
+    }
+
+  bool isLocal() const
     {
-    this->TcpServer = 0;
-    this->TcpSocket = 0;
-    this->Handler = 0;
+    return this->TypeCombo->currentIndex() >= 2;
     }
 
-  QTcpServer* TcpServer;
-  QTcpSocket* TcpSocket;
+  pqSocketHandler::ProtocolType selectedProtocol() const
+    {
+    switch (this->ProtocolCombo->currentIndex())
+      {
+      case 1:
+        return pqSocketHandler::FramedProtocol;
+      case 2:
+        return pqSocketHandler::RequestProtocol;
+      default:
+        return pqSocketHandler::RawProtocol;
+      }
+    }
 
   QComboBox*     TypeCombo;
+  QComboBox*     ProtocolCombo;
+  QComboBox*     HandlerCombo;
   QLineEdit*     PortEdit;
   QLineEdit*     HostEdit;
+  QSpinBox*      ClientsSpin;
+  QCheckBox*     RetryCheck;
   QPushButton*   StatusButton;
 
-  pqSocketHandler* Handler;
+  QList<pqSocketHandler*> Handlers;
+  pqSocketEndpoint* Endpoint;
 };
 
 //-----------------------------------------------------------------------------
@@ -74,8 +94,20 @@ pqSocketItem::pqSocketItem(QObject* parent) : QObject(parent)
   this->Internal->TypeCombo = new QComboBox;
   this->Internal->TypeCombo->addItem("client");
   this->Internal->TypeCombo->addItem("server");
+  this->Internal->TypeCombo->addItem("local client");
+  this->Internal->TypeCombo->addItem("local server");
+  this->Internal->ProtocolCombo = new QComboBox;
+  this->Internal->ProtocolCombo->addItem("raw");
+  this->Internal->ProtocolCombo->addItem("framed");
+  this->Internal->ProtocolCombo->addItem("request");
+  this->Internal->HandlerCombo = new QComboBox;
   this->Internal->HostEdit = new QLineEdit("localhost");
   this->Internal->PortEdit = new QLineEdit("9000");
+  this->Internal->ClientsSpin = new QSpinBox;
+  this->Internal->ClientsSpin->setRange(1, 256);
+  this->Internal->ClientsSpin->setToolTip("Maximum number of simultaneous clients");
+  this->Internal->RetryCheck = new QCheckBox;
+  this->Internal->RetryCheck->setToolTip("Reconnect automatically when the connection fails or is lost");
   this->Internal->StatusButton = new QPushButton();
   this->Internal->StatusButton->setMinimumWidth(100);
   this->Internal->StatusButton->setCheckable(true);
@@ -83,6 +115,12 @@ pqSocketItem::pqSocketItem(QObject* parent) : QObject(parent)
   this->connect(this->Internal->TypeCombo, SIGNAL(currentIndexChanged(int)), SLOT(onTypeChanged()));
   this->connect(this->Internal->StatusButton, SIGNAL(clicked()), SLOT(onStatusClicked()));
 
+  this->Internal->Endpoint = new pqSocketEndpoint(this);
+  this->connect(this->Internal->Endpoint, SIGNAL(statusChanged()),
+                SLOT(onEndpointStatusChanged()));
+  this->connect(this->Internal->Endpoint, SIGNAL(stopped(const QString&)),
+                SLOT(onEndpointStopped(const QString&)));
+
   this->onTypeChanged();
 }
 
@@ -98,216 +136,134 @@ void pqSocketItem::addWidgetsToLayout(QGridLayout* layout)
   int row = layout->rowCount();
 
   layout->addWidget(this->Internal->TypeCombo, row, 0);
-  layout->addWidget(this->Internal->HostEdit, row, 1);
-  layout->addWidget(this->Internal->PortEdit, row, 2);
-  layout->addWidget(this->Internal->StatusButton, row, 3);
+  layout->addWidget(this->Internal->ProtocolCombo, row, 1);
+  layout->addWidget(this->Internal->HandlerCombo, row, 2);
+  layout->addWidget(this->Internal->HostEdit, row, 3);
+  layout->addWidget(this->Internal->PortEdit, row, 4);
+  layout->addWidget(this->Internal->ClientsSpin, row, 5);
+  layout->addWidget(this->Internal->RetryCheck, row, 6);
+  layout->addWidget(this->Internal->StatusButton, row, 7);
 }
 
 //-----------------------------------------------------------------------------
-void pqSocketItem::setHandler(pqSocketHandler* handler)
+void pqSocketItem::addHandler(const QString& name, pqSocketHandler* handler)
 {
-  this->Internal->Handler = handler;
+  this->Internal->Handlers.append(handler);
+  this->Internal->HandlerCombo->addItem(name);
 }
 
 //-----------------------------------------------------------------------------
-void pqSocketItem::onTypeChanged()
+void pqSocketItem::setScheduler(pqSocketScheduler* scheduler)
 {
-  if (this->Internal->TypeCombo->currentIndex() == 0)
-    {
-    this->Internal->HostEdit->setEnabled(true);
-    this->Internal->StatusButton->setText("Connect");
-    }
-  else
-    {
-    this->Internal->HostEdit->setEnabled(false);
-    this->Internal->StatusButton->setText("Listen");
-    }
+  this->Internal->Endpoint->setScheduler(scheduler);
 }
 
 //-----------------------------------------------------------------------------
-bool pqSocketItem::openListeningSocket()
+void pqSocketItem::setIOThread(pqSocketIOThread* thread)
 {
-  QString portString = this->Internal->PortEdit->text();
-
-  bool portOk;
-  int port = portString.toInt(&portOk);
-  if (!portOk)
-    {
-    QMessageBox::critical(0, "Invalid port",
-      QString("The string '%1' is not a valid port number.").arg(portString));
-    return false;
-    }
-
-  this->Internal->TcpServer = new QTcpServer(this);
-  this->connect(this->Internal->TcpServer, SIGNAL(newConnection()), SLOT(onNewConnection()));
-
-  bool success = this->Internal->TcpServer->listen(QHostAddress::Any, port);
-  if (!success)
-    {
-    delete this->Internal->TcpServer;
-    this->Internal->TcpServer = 0;
-
-    QMessageBox::critical(0, "Socket error",
-      QString("Failed to open a listening socket on port %1.").arg(port));
-    }
-
-  return success;
+  this->Internal->Endpoint->setIOThread(thread);
 }
 
 //-----------------------------------------------------------------------------
-bool pqSocketItem::connectToHost()
+void pqSocketItem::onTypeChanged()
 {
-  QString portString = this->Internal->PortEdit->text();
-
-  bool portOk;
-  int port = portString.toInt(&portOk);
-  if (!portOk)
+  bool isLocal = this->Internal->isLocal();
+  this->Internal->PortEdit->setToolTip(isLocal ? "Name of the local socket" : "TCP port");
+  if (isLocal && this->Internal->PortEdit->text() == "9000")
     {
-    QMessageBox::critical(0, "Invalid port",
-      QString("The string '%1' is not a valid port number.").arg(portString));
-    return false;
+    this->Internal->PortEdit->setText("paraview-remote");
     }
-
-  QString hostString = this->Internal->HostEdit->text();
-  if (hostString.isEmpty())
+  else if (!isLocal && this->Internal->PortEdit->text() == "paraview-remote")
     {
-    QMessageBox::critical(0, "Invalid host",
-      QString("The host string is empty."));
-    return false;
+    this->Internal->PortEdit->setText("9000");
     }
 
-  this->Internal->TcpSocket = new QTcpSocket(this);
-  this->Internal->TcpSocket->connectToHost(hostString, port);
-  bool success = this->Internal->TcpSocket->waitForConnected(1000);
-
-  if (!success)
+  if (this->Internal->isClient())
     {
-    delete this->Internal->TcpSocket;
-    this->Internal->TcpSocket = 0;
-
-    QMessageBox::critical(0, "Socket error",
-      QString("Failed to connect to %1 on port %2.").arg(hostString).arg(port));
+    this->Internal->HostEdit->setEnabled(!isLocal);
+    this->Internal->ClientsSpin->setEnabled(false);
+    this->Internal->RetryCheck->setEnabled(true);
+    this->Internal->StatusButton->setText("Connect");
     }
   else
     {
-    this->Internal->Handler->setSocket(this->Internal->TcpSocket);
-    this->Internal->Handler->onSocketOpened();
-    this->connect(this->Internal->TcpSocket, SIGNAL(readyRead()), SLOT(onSocketReadReady()));
-    this->connect(this->Internal->TcpSocket, SIGNAL(disconnected()), SLOT(onSocketClosed()));
+    this->Internal->HostEdit->setEnabled(false);
+    this->Internal->ClientsSpin->setEnabled(true);
+    this->Internal->RetryCheck->setEnabled(false);
+    this->Internal->StatusButton->setText("Listen");
     }
+}
 
-  return success;
+//-----------------------------------------------------------------------------
+void pqSocketItem::reportError(const QString& message)
+{
+  // Shown on the status button like a failed connection, rather than in a
+  // dialog that would block the GUI.
+  this->Internal->StatusButton->setToolTip(message);
+  qWarning("Remote control: %s", qPrintable(message));
 }
 
 //-----------------------------------------------------------------------------
 void pqSocketItem::onStatusClicked()
 {
-  bool buttonIsChecked = this->Internal->StatusButton->isChecked();
-
-  if (this->Internal->TypeCombo->currentIndex() == 0)
+  pqSocketEndpoint* endpoint = this->Internal->Endpoint;
+  if (!this->Internal->StatusButton->isChecked())
     {
-    // client
-
-    if (!buttonIsChecked)
-      {
-      if (this->Internal->TcpSocket)
-        {
-        this->Internal->TcpSocket->close();
-        this->Internal->TcpSocket = 0;
-        }
-
-      this->Internal->StatusButton->setText("Connect");
-      this->setWidgetsEnabled(true);
-      }
-    else
+    endpoint->stop();
+    this->Internal->StatusButton->setText(this->Internal->isClient() ? "Connect" : "Listen");
+    if (this->Internal->isClient())
       {
-      bool success = this->connectToHost();
-      if (success)
-        {
-        this->setWidgetsEnabled(false);
-        this->Internal->StatusButton->setText("Connected");
-        }
-      else
-        {
-        this->Internal->StatusButton->setChecked(false);
-        }
+      this->Internal->StatusButton->setToolTip(QString());
       }
-
+    this->setWidgetsEnabled(true);
+    return;
     }
-  else
-    {
-    // server
 
-    if (!buttonIsChecked)
-      {
-      if (this->Internal->TcpSocket)
-        {
-        this->Internal->TcpSocket->close();
-        this->Internal->TcpSocket = 0;
-        }
-      if (this->Internal->TcpServer)
-        {
-        this->Internal->TcpServer->close();
-        this->Internal->TcpServer->deleteLater();
-        this->Internal->TcpServer = 0;
-        }
-
-      this->Internal->StatusButton->setText("Listen");
-      this->setWidgetsEnabled(true);
-      }
-    else
-      {
-      bool success = this->openListeningSocket();
-      if (success)
-        {
-        this->setWidgetsEnabled(false);
-        this->Internal->StatusButton->setText("Waiting");
-        }
-      else
-        {
-        this->Internal->StatusButton->setChecked(false);
-        }
-      }
+  int handler = this->Internal->HandlerCombo->currentIndex();
+  endpoint->setSocketType(
+    static_cast<pqSocketEndpoint::SocketType>(this->Internal->TypeCombo->currentIndex()));
+  endpoint->setProtocol(this->Internal->selectedProtocol());
+  endpoint->setHandler(handler >= 0 ? this->Internal->Handlers[handler] : 0);
+  endpoint->setAddress(this->Internal->HostEdit->text(), this->Internal->PortEdit->text());
+  endpoint->setMaximumClients(this->Internal->ClientsSpin->value());
+  endpoint->setRetry(this->Internal->RetryCheck->isChecked());
+  if (!endpoint->start())
+    {
+    this->reportError(endpoint->errorString());
+    this->Internal->StatusButton->setChecked(false);
+    return;
     }
-
+  this->setWidgetsEnabled(false);
 }
 
 //-----------------------------------------------------------------------------
-void pqSocketItem::setWidgetsEnabled(bool enabled)
+void pqSocketItem::onEndpointStatusChanged()
 {
-  bool isClient = this->Internal->TypeCombo->currentIndex() == 0;
-  this->Internal->TypeCombo->setEnabled(enabled);
-  this->Internal->PortEdit->setEnabled(enabled);
-  this->Internal->HostEdit->setEnabled(enabled && isClient);
-}
-
-//-----------------------------------------------------------------------------
-void pqSocketItem::onNewConnection()
-{
-  this->Internal->TcpSocket = this->Internal->TcpServer->nextPendingConnection();
-  if (this->Internal->TcpSocket)
+  pqSocketEndpoint* endpoint = this->Internal->Endpoint;
+  if (endpoint->isStarted())
     {
-    this->Internal->Handler->setSocket(this->Internal->TcpSocket);
-    this->Internal->Handler->onSocketOpened();
-    this->connect(this->Internal->TcpSocket, SIGNAL(readyRead()), SLOT(onSocketReadReady()));
-    this->connect(this->Internal->TcpSocket, SIGNAL(disconnected()), SLOT(onSocketClosed()));
-    this->Internal->TcpServer->close();
-    this->Internal->StatusButton->setText("Connected");
+    this->Internal->StatusButton->setText(endpoint->status());
     }
+  this->Internal->StatusButton->setToolTip(endpoint->detail());
 }
 
 //-----------------------------------------------------------------------------
-void pqSocketItem::onSocketClosed()
+void pqSocketItem::onEndpointStopped(const QString& reason)
 {
-  this->Internal->Handler->setSocket(0);
-  this->Internal->Handler->onSocketClosed();
-
   this->Internal->StatusButton->setChecked(false);
   this->onStatusClicked();
+  this->Internal->StatusButton->setToolTip(reason);
 }
 
 //-----------------------------------------------------------------------------
-void pqSocketItem::onSocketReadReady()
+void pqSocketItem::setWidgetsEnabled(bool enabled)
 {
-  this->Internal->Handler->onSocketReadReady();
+  bool isClient = this->Internal->isClient();
+  this->Internal->TypeCombo->setEnabled(enabled);
+  this->Internal->ProtocolCombo->setEnabled(enabled);
+  this->Internal->HandlerCombo->setEnabled(enabled);
+  this->Internal->PortEdit->setEnabled(enabled);
+  this->Internal->HostEdit->setEnabled(enabled && isClient && !this->Internal->isLocal());
+  this->Internal->ClientsSpin->setEnabled(enabled && !isClient);
+  this->Internal->RetryCheck->setEnabled(enabled && isClient);
 }
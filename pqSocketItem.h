@@ -35,8 +35,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QObject>
 
 class QGridLayout;
+class pqSocketEndpoint;
 class pqSocketHandler;
+class pqSocketIOThread;
+class pqSocketScheduler;
 
+// A row of widgets in the dock for one pqSocketEndpoint: its type,
+// protocol, handler and address, and a status button that starts and stops
+// it.
 class pqSocketItem : public QObject
 {
   Q_OBJECT
@@ -47,22 +53,28 @@ public:
   virtual ~pqSocketItem();
 
   void addWidgetsToLayout(QGridLayout* layout);
-  void setHandler(pqSocketHandler* handler);
+
+  // Adds a choice to the handler combo box.  The handler is a prototype,
+  // every connection gets its own handler created with
+  // pqSocketHandler::newInstance().
+  void addHandler(const QString& name, pqSocketHandler* handler);
+
+  // Executes the messages of all connections.
+  void setScheduler(pqSocketScheduler* scheduler);
+
+  // Connections opened while set do their network I/O in that thread.
+  void setIOThread(pqSocketIOThread* thread);
 
 protected slots:
 
   void onStatusClicked();
   void onTypeChanged();
-
-  void onNewConnection();
-  void onSocketReadReady();
-  void onSocketClosed();
+  void onEndpointStatusChanged();
+  void onEndpointStopped(const QString& reason);
 
 protected:
 
-  bool openListeningSocket();
-  bool connectToHost();
-
+  void reportError(const QString& message);
   void setWidgetsEnabled(bool enabled);
 
 private:
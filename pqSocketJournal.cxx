@@ -0,0 +1,274 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketJournal.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketJournal.h"
+#include "pqSocketHandler.h"
+
+#include <QFile>
+
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+const char* pqSocketJournal::magic()
+{
+  return "PVRCJNL1";
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournal::pqSocketJournal()
+{
+  this->File = 0;
+  this->Start = 0;
+  this->Records = 0;
+  this->Bytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournal::~pqSocketJournal()
+{
+  this->close();
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournal::open(const QString& fileName, QString* error)
+{
+  this->close();
+
+  QFile* file = new QFile(fileName);
+  if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)
+      || file->write(magic(), MagicSize) != MagicSize)
+    {
+    *error = file->errorString();
+    delete file;
+    return false;
+    }
+
+  this->File = file;
+  this->Start = pqSocketHandler::currentTime();
+  this->Records = 0;
+  this->Bytes = MagicSize;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournal::close()
+{
+  delete this->File;
+  this->File = 0;
+  this->Connections.clear();
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketJournal::fileName() const
+{
+  return this->File ? this->File->fileName() : QString();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournal::recordConnection(quint32 connection, quint16 protocol,
+                                       const QString& handler, const QString& name)
+{
+  if (!this->File)
+    {
+    return;
+    }
+
+  QByteArray payload = QString("%1\t%2").arg(handler, name).toUtf8();
+  pqRecord record;
+  record.Connection = connection;
+  record.Time = qMax<qint64>(0, pqSocketHandler::currentTime() - this->Start);
+  record.ExecuteTime = 0;
+  record.Protocol = protocol;
+  record.Header = pqSocketMessageHeader(0, ConnectionRecord);
+  record.Payload = payload.constData();
+  this->write(record, payload.size());
+  this->Connections.insert(connection);
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketJournal::recordMessage(quint32 connection, quint16 protocol,
+                                      const pqSocketMessageHeader& header,
+                                      const char* payload, int payloadSize,
+                                      qint64 arrival)
+{
+  if (!this->File)
+    {
+    return -1;
+    }
+
+  pqRecord record;
+  record.Connection = connection;
+  record.Time = qMax<qint64>(0, arrival - this->Start);
+  record.ExecuteTime = 0;
+  record.Protocol = protocol;
+  record.Header = header;
+  record.Payload = payload;
+  qint64 offset = this->File->pos();
+  return this->write(record, payloadSize) ? offset : -1;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournal::recordExecuteTime(qint64 record, qint64 execute)
+{
+  // Records written in the meantime, by messages that ran while this one
+  // spun the event loop, stay where they are.
+  qint64 end = this->File ? this->File->pos() : 0;
+  if (record < MagicSize || record + RecordHeaderSize > end)
+    {
+    return;
+    }
+  uchar bytes[4];
+  qToBigEndian<quint32>(static_cast<quint32>(qBound<qint64>(0, execute, 0xffffffff)), bytes);
+  if (!this->File->seek(record + 16)
+      || this->File->write(reinterpret_cast<const char*>(bytes), 4) != 4
+      || !this->File->seek(end)
+      || !this->File->flush())
+    {
+    qCritical("Remote control: stopped writing the journal %s: %s",
+              qPrintable(this->File->fileName()), qPrintable(this->File->errorString()));
+    this->close();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournal::write(const pqRecord& record, int payloadSize)
+{
+  uchar bytes[RecordHeaderSize];
+  qToBigEndian<quint32>(static_cast<quint32>(payloadSize), bytes);
+  qToBigEndian<quint32>(record.Connection, bytes + 4);
+  qToBigEndian<quint64>(record.Time, bytes + 8);
+  qToBigEndian<quint32>(record.ExecuteTime, bytes + 16);
+  qToBigEndian<quint32>(record.Header.RequestId, bytes + 20);
+  qToBigEndian<quint16>(record.Header.Type, bytes + 24);
+  qToBigEndian<quint16>(record.Header.Flags, bytes + 26);
+  qToBigEndian<quint16>(record.Protocol, bytes + 28);
+  qToBigEndian<quint16>(0, bytes + 30);
+
+  // Each record is flushed so that the journal of a session that crashes
+  // ParaView is complete up to the message that did it, which is written
+  // before it runs.
+  if (this->File->write(reinterpret_cast<const char*>(bytes), RecordHeaderSize) != RecordHeaderSize
+      || this->File->write(record.Payload, payloadSize) != payloadSize
+      || !this->File->flush())
+    {
+    qCritical("Remote control: stopped writing the journal %s: %s",
+              qPrintable(this->File->fileName()), qPrintable(this->File->errorString()));
+    this->close();
+    return false;
+    }
+  this->Records++;
+  this->Bytes += RecordHeaderSize + payloadSize;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournalReader::pqSocketJournalReader()
+{
+  this->File = 0;
+  this->Data = 0;
+  this->Size = 0;
+  this->Position = 0;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournalReader::~pqSocketJournalReader()
+{
+  this->close();
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournalReader::open(const QString& fileName, QString* error)
+{
+  this->close();
+
+  QFile* file = new QFile(fileName);
+  if (!file->open(QIODevice::ReadOnly))
+    {
+    *error = file->errorString();
+    delete file;
+    return false;
+    }
+
+  qint64 size = file->size();
+  const uchar* data = size >= pqSocketJournal::MagicSize ? file->map(0, size) : 0;
+  if (!data || memcmp(data, pqSocketJournal::magic(), pqSocketJournal::MagicSize) != 0)
+    {
+    *error = QString("%1 is not a remote control journal.").arg(fileName);
+    delete file;
+    return false;
+    }
+
+  this->File = file;
+  this->Data = data;
+  this->Size = size;
+  this->Position = pqSocketJournal::MagicSize;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournalReader::close()
+{
+  // Deleting the file unmaps it.
+  delete this->File;
+  this->File = 0;
+  this->Data = 0;
+  this->Size = 0;
+  this->Position = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournalReader::next(pqSocketJournal::pqRecord& record)
+{
+  if (!this->Data || this->Size - this->Position < pqSocketJournal::RecordHeaderSize)
+    {
+    return false;
+    }
+
+  const uchar* bytes = this->Data + this->Position;
+  quint32 payloadSize = qFromBigEndian<quint32>(bytes);
+  if (this->Size - this->Position - pqSocketJournal::RecordHeaderSize < payloadSize)
+    {
+    return false;
+    }
+
+  record.Connection = qFromBigEndian<quint32>(bytes + 4);
+  record.Time = qFromBigEndian<quint64>(bytes + 8);
+  record.ExecuteTime = qFromBigEndian<quint32>(bytes + 16);
+  record.Header = pqSocketMessageHeader(qFromBigEndian<quint32>(bytes + 20),
+                                        qFromBigEndian<quint16>(bytes + 24),
+                                        qFromBigEndian<quint16>(bytes + 26));
+  record.Header.PayloadSize = payloadSize;
+  record.Protocol = qFromBigEndian<quint16>(bytes + 28);
+  record.Payload = reinterpret_cast<const char*>(bytes + pqSocketJournal::RecordHeaderSize);
+  this->Position += pqSocketJournal::RecordHeaderSize + payloadSize;
+  return true;
+}
@@ -0,0 +1,149 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketJournal.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketJournal_h
+#define _pqSocketJournal_h
+
+#include "pqSocketMessage.h"
+
+#include <QSet>
+#include <QString>
+
+class QFile;
+
+// Append-only log of the messages executed by all connections, used to
+// reproduce a session.  The file starts with the 8 bytes "PVRCJNL1",
+// followed by records whose integers are big-endian:
+//
+//   quint32 payload size in bytes
+//   quint32 connection id
+//   quint64 arrival time in microseconds since the recording started
+//   quint32 execution time in microseconds
+//   quint32 request id
+//   quint16 message type, 0 for a connection record
+//   quint16 flags
+//   quint16 protocol of the connection
+//   quint16 reserved, 0
+//   char[]  payload, uncompressed
+//
+// A connection record precedes the first message of every connection, its
+// payload is the class name of the connection's handler followed by a tab
+// and the connection name.  Records are written as messages start and their
+// execution time is filled in once they return, so the journal of a session
+// that crashed ends with the message that did it, with an execution time of
+// 0.  Messages are not executed in order of arrival, so arrival times are not
+// necessarily increasing.
+class pqSocketJournal
+{
+public:
+
+  enum
+    {
+    MagicSize = 8,
+    RecordHeaderSize = 32,
+    ConnectionRecord = 0
+    };
+
+  struct pqRecord
+    {
+    quint32 Connection;
+    quint64 Time;
+    quint32 ExecuteTime;
+    quint16 Protocol;
+    pqSocketMessageHeader Header;
+    const char* Payload;
+    };
+
+  static const char* magic();
+
+  pqSocketJournal();
+  ~pqSocketJournal();
+
+  // Creates or truncates the file.  Returns false and sets error on failure.
+  bool open(const QString& fileName, QString* error);
+  void close();
+  bool isOpen() const {return this->File != 0;}
+  QString fileName() const;
+
+  void recordConnection(quint32 connection, quint16 protocol, const QString& handler,
+                        const QString& name);
+  // Returns the offset of the record for recordExecuteTime(), -1 if nothing
+  // was written.
+  qint64 recordMessage(quint32 connection, quint16 protocol,
+                       const pqSocketMessageHeader& header,
+                       const char* payload, int payloadSize, qint64 arrival);
+  void recordExecuteTime(qint64 record, qint64 execute);
+
+  bool hasConnection(quint32 connection) const {return this->Connections.contains(connection);}
+
+  quint64 records() const {return this->Records;}
+  quint64 bytes() const {return this->Bytes;}
+
+private:
+
+  bool write(const pqRecord& record, int payloadSize);
+
+  QFile* File;
+  qint64 Start;
+  QSet<quint32> Connections;
+  quint64 Records;
+  quint64 Bytes;
+};
+
+// Reads a journal mapped in memory, the payloads of the records point into
+// the mapping and stay valid until the reader is closed.
+class pqSocketJournalReader
+{
+public:
+
+  pqSocketJournalReader();
+  ~pqSocketJournalReader();
+
+  bool open(const QString& fileName, QString* error);
+  void close();
+
+  // Reads the next record, returns false at the end of the journal or at a
+  // truncated record.
+  bool next(pqSocketJournal::pqRecord& record);
+  void rewind() {this->Position = pqSocketJournal::MagicSize;}
+
+  qint64 size() const {return this->Size;}
+  qint64 position() const {return this->Position;}
+
+private:
+
+  QFile* File;
+  const uchar* Data;
+  qint64 Size;
+  qint64 Position;
+};
+
+#endif
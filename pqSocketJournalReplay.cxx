@@ -0,0 +1,339 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketJournalReplay.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketJournalReplay.h"
+#include "pqSocketHandler.h"
+#include "pqSocketJournal.h"
+#include "pqSocketStatistics.h"
+
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QStringList>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace
+{
+  struct pqReplayedMessage
+    {
+    quint64 Index;
+    quint32 Connection;
+    quint16 Type;
+    int Size;
+    qint64 Recorded;
+    qint64 Replayed;
+    const char* Payload;
+    };
+
+  bool slowedDownMore(const pqReplayedMessage& a, const pqReplayedMessage& b)
+    {
+    return a.Replayed - a.Recorded > b.Replayed - b.Recorded;
+    }
+
+  // The beginning of a script, or the type and size of other messages.
+  QString describe(const pqReplayedMessage& message)
+    {
+    if (message.Type == pqSocketMessageHeader::ScriptMessage || message.Type == 0)
+      {
+      return QString::fromUtf8(message.Payload, qMin(message.Size, 60)).simplified();
+      }
+    return QString("type %1, %2 bytes").arg(message.Type).arg(message.Size);
+    }
+}
+
+//-----------------------------------------------------------------------------
+class pqSocketJournalReplay::pqInternal
+{
+public:
+
+  pqInternal()
+    {
+    this->OriginalPacing = false;
+    this->Running = false;
+    this->HasRecord = false;
+    this->Start = 0;
+    this->End = 0;
+    this->FirstTime = 0;
+    this->LastTime = 0;
+    this->Bytes = 0;
+    this->Skipped = 0;
+    }
+
+  pqSocketJournalReader Reader;
+  QMap<QString, pqSocketHandler*> Prototypes;
+  QMap<quint32, pqSocketHandler*> Handlers;
+  QTimer Timer;
+  bool OriginalPacing;
+  bool Running;
+
+  // The record read ahead while waiting for its time to come.
+  pqSocketJournal::pqRecord Record;
+  bool HasRecord;
+
+  qint64 Start;
+  qint64 End;
+  quint64 FirstTime;
+  quint64 LastTime;
+  quint64 Bytes;
+  quint64 Skipped;
+  QList<pqReplayedMessage> Messages;
+  pqSocketHistogram Recorded;
+  pqSocketHistogram Replayed;
+};
+
+//-----------------------------------------------------------------------------
+pqSocketJournalReplay::pqSocketJournalReplay(QObject* parent) : QObject(parent)
+{
+  this->Internal = new pqInternal;
+  this->Internal->Timer.setSingleShot(true);
+  this->connect(&this->Internal->Timer, SIGNAL(timeout()), SLOT(replayMessages()));
+}
+
+//-----------------------------------------------------------------------------
+pqSocketJournalReplay::~pqSocketJournalReplay()
+{
+  qDeleteAll(this->Internal->Handlers);
+  qDeleteAll(this->Internal->Prototypes);
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournalReplay::addPrototype(pqSocketHandler* prototype)
+{
+  prototype->setParent(this);
+  this->Internal->Prototypes.insert(prototype->metaObject()->className(), prototype);
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournalReplay::start(const QString& fileName, bool originalPacing, QString* error)
+{
+  this->stop();
+  if (!this->Internal->Reader.open(fileName, error))
+    {
+    return false;
+    }
+
+  qDeleteAll(this->Internal->Handlers);
+  this->Internal->Handlers.clear();
+  this->Internal->Messages.clear();
+  this->Internal->Recorded.reset();
+  this->Internal->Replayed.reset();
+  this->Internal->Bytes = 0;
+  this->Internal->Skipped = 0;
+  this->Internal->HasRecord = false;
+  this->Internal->OriginalPacing = originalPacing;
+  this->Internal->Running = true;
+  this->Internal->Start = pqSocketHandler::currentTime();
+  this->Internal->End = this->Internal->Start;
+  this->Internal->FirstTime = 0;
+  this->Internal->LastTime = 0;
+  this->Internal->Timer.start(0);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournalReplay::stop()
+{
+  if (this->Internal->Running)
+    {
+    this->Internal->Timer.stop();
+    this->Internal->Running = false;
+    this->Internal->End = pqSocketHandler::currentTime();
+    emit this->finished();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournalReplay::isRunning() const
+{
+  return this->Internal->Running;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketJournalReplay::replayMessages()
+{
+  pqInternal* internal = this->Internal;
+  qint64 turnEnd = pqSocketHandler::currentTime() + 20000;
+  while (internal->Running)
+    {
+    if (!internal->HasRecord)
+      {
+      bool first = internal->Reader.position() == pqSocketJournal::MagicSize;
+      if (!internal->Reader.next(internal->Record))
+        {
+        this->stop();
+        return;
+        }
+      internal->HasRecord = true;
+      if (first)
+        {
+        internal->FirstTime = internal->Record.Time;
+        }
+      }
+
+    const pqSocketJournal::pqRecord& record = internal->Record;
+    qint64 now = pqSocketHandler::currentTime();
+    if (internal->OriginalPacing)
+      {
+      // Records are in the order the messages started, one that arrived
+      // before the previous one started is replayed right away.
+      qint64 due = internal->Start
+        + static_cast<qint64>(record.Time) - static_cast<qint64>(internal->FirstTime);
+      if (due > now)
+        {
+        internal->Timer.start(static_cast<int>((due - now + 999) / 1000));
+        return;
+        }
+      }
+    if (now > turnEnd)
+      {
+      internal->Timer.start(0);
+      return;
+      }
+    internal->HasRecord = false;
+    internal->LastTime = qMax(internal->LastTime, record.Time);
+
+    if (record.Header.Type == pqSocketJournal::ConnectionRecord)
+      {
+      QString description = QString::fromUtf8(record.Payload, record.Header.PayloadSize);
+      pqSocketHandler* prototype = internal->Prototypes.value(description.section('\t', 0, 0));
+      if (prototype && !internal->Handlers.contains(record.Connection))
+        {
+        pqSocketHandler* handler = prototype->newInstance(this);
+        handler->setProtocol(static_cast<pqSocketHandler::ProtocolType>(record.Protocol));
+        handler->statistics().setName(description.section('\t', 1));
+        internal->Handlers.insert(record.Connection, handler);
+        }
+      continue;
+      }
+
+    pqSocketHandler* handler = internal->Handlers.value(record.Connection);
+    if (!handler)
+      {
+      internal->Skipped++;
+      continue;
+      }
+
+    pqReplayedMessage message;
+    message.Index = internal->Messages.size();
+    message.Connection = record.Connection;
+    message.Type = handler->protocol() == pqSocketHandler::RequestProtocol ? record.Header.Type : 0;
+    message.Size = static_cast<int>(record.Header.PayloadSize);
+    message.Recorded = record.ExecuteTime;
+    message.Payload = record.Payload;
+    message.Replayed = handler->replayMessage(record.Header, record.Payload, message.Size);
+    internal->Messages.append(message);
+    internal->Recorded.add(message.Recorded);
+    internal->Replayed.add(message.Replayed);
+    internal->Bytes += message.Size;
+    }
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketJournalReplay::report() const
+{
+  const pqInternal* internal = this->Internal;
+  double seconds = (internal->End - internal->Start) / 1e6;
+  double recordedSeconds = (internal->LastTime - internal->FirstTime) / 1e6;
+  int count = internal->Messages.size();
+
+  QStringList lines;
+  lines << QString("Replayed %1 messages of %2 connections in %3 s: %4 messages/s, %5 MB/s.")
+    .arg(count).arg(internal->Handlers.size())
+    .arg(seconds, 0, 'f', 2)
+    .arg(seconds > 0 ? count / seconds : 0.0, 0, 'f', 1)
+    .arg(seconds > 0 ? internal->Bytes / seconds / (1024*1024) : 0.0, 0, 'f', 2);
+  lines << QString("The recorded session took %1 s.").arg(recordedSeconds, 0, 'f', 2);
+  lines << "Messages were executed directly, without the scheduler queue, batching "
+           "or the receive buffer; compare execution times, not waits.";
+  if (internal->Skipped)
+    {
+    lines << QString("%1 messages of connections with an unknown handler were skipped.")
+      .arg(internal->Skipped);
+    }
+
+  const pqSocketHistogram* histograms[] = {&internal->Recorded, &internal->Replayed};
+  const char* names[] = {"Recorded", "Replayed"};
+  for (int i = 0; i < 2; ++i)
+    {
+    lines << QString("%1 execution: total %2 ms, p50 %3 ms, p99 %4 ms, max %5 ms.")
+      .arg(names[i])
+      .arg(histograms[i]->total() / 1000.0, 0, 'f', 1)
+      .arg(histograms[i]->percentile(0.5) / 1000.0, 0, 'f', 2)
+      .arg(histograms[i]->percentile(0.99) / 1000.0, 0, 'f', 2)
+      .arg(histograms[i]->maximum() / 1000.0, 0, 'f', 2);
+    }
+
+  QList<pqReplayedMessage> messages = internal->Messages;
+  std::sort(messages.begin(), messages.end(), slowedDownMore);
+  lines << "Largest slowdowns:";
+  for (int i = 0; i < qMin(10, messages.size()); ++i)
+    {
+    const pqReplayedMessage& message = messages[i];
+    if (message.Replayed <= message.Recorded)
+      {
+      break;
+      }
+    lines << QString("  %1 ms (%2 -> %3 ms), message %4 of connection %5: %6")
+      .arg((message.Replayed - message.Recorded) / 1000.0, 0, 'f', 2)
+      .arg(message.Recorded / 1000.0, 0, 'f', 2)
+      .arg(message.Replayed / 1000.0, 0, 'f', 2)
+      .arg(message.Index).arg(message.Connection)
+      .arg(describe(message));
+    }
+  return lines.join("\n");
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketJournalReplay::writeCSV(const QString& fileName, QString* error) const
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+    *error = file.errorString();
+    return false;
+    }
+
+  QTextStream stream(&file);
+  stream << "index,connection,type,bytes,recorded_us,replayed_us,difference_us,message\n";
+  foreach (const pqReplayedMessage& message, this->Internal->Messages)
+    {
+    stream << message.Index << "," << message.Connection << "," << message.Type << ","
+           << message.Size << "," << message.Recorded << "," << message.Replayed << ","
+           << message.Replayed - message.Recorded << ",\""
+           << describe(message).replace('"', "\"\"") << "\"\n";
+    }
+  return true;
+}
@@ -0,0 +1,85 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketJournalReplay.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketJournalReplay_h
+#define _pqSocketJournalReplay_h
+
+#include <QObject>
+
+class pqSocketHandler;
+
+// Feeds a journal (see pqSocketJournal) back through handlers of the
+// recorded types, either at the pace of the recorded session or as fast as
+// possible, and compares the execution time of every message with the
+// recorded one.  Messages run from the event loop in turns of at most 20 ms
+// so that ParaView stays responsive and can render.  They are dispatched to
+// the handlers directly rather than through pqSocketScheduler, so the
+// replay measures execution only, not queueing or batching.
+class pqSocketJournalReplay : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketJournalReplay(QObject* parent);
+  virtual ~pqSocketJournalReplay();
+
+  // Handlers are created from the prototype with the class name recorded
+  // for each connection.  The replay takes ownership of the prototype.
+  void addPrototype(pqSocketHandler* prototype);
+
+  // Returns false and sets error if the journal cannot be read.
+  bool start(const QString& fileName, bool originalPacing, QString* error);
+  void stop();
+  bool isRunning() const;
+
+  // Summary of the last replay: throughput, execution times and the
+  // messages that slowed down the most.
+  QString report() const;
+
+  // One line per replayed message with its recorded and replayed execution
+  // times.
+  bool writeCSV(const QString& fileName, QString* error) const;
+
+signals:
+
+  void finished();
+
+protected slots:
+
+  void replayMessages();
+
+private:
+  class pqInternal;
+  pqInternal* Internal;
+};
+
+#endif
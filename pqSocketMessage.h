@@ -0,0 +1,165 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketMessage.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketMessage_h
+#define _pqSocketMessage_h
+
+#include <QString>
+#include <QtEndian>
+
+// Header used by the request protocol.  All fields are big-endian:
+//
+//   quint32 payload size in bytes, not counting the header
+//   quint32 request id, echoed back in the reply
+//   quint16 message type
+//   quint16 flags
+class pqSocketMessageHeader
+{
+public:
+
+  enum
+    {
+    Size = 12
+    };
+
+  enum MessageType
+    {
+    ScriptMessage = 1,
+    ReplyMessage = 2,
+    ArrayMessage = 3,
+    ImageMessage = 4,
+    SharedArrayMessage = 5,
+    ConfigureMessage = 6,
+    StatisticsMessage = 7,
+    EventMessage = 8,
+    FetchMessage = 9,
+    DataMessage = 10,
+    CancelMessage = 11,
+    SweepMessage = 12
+    };
+
+  // Flags of a ScriptMessage.  With SendImageFlag the active view is sent
+  // as an ImageMessage after the reply, encoded with the codec stored in the
+  // ImageCodecMask bits (see pqSocketImageEncoder).  ComputeFlag runs the
+  // script in a worker thread (see pqPythonComputeLane).
+  enum MessageFlags
+    {
+    SendImageFlag = 0x0001,
+    ImageDeltaFlag = 0x0002,
+    ImageCodecMask = 0x000C,
+    ImageCodecShift = 2,
+    ComputeFlag = 0x0010,
+    // Priority of any request, 0 to 3.  The scheduler serves the connections
+    // whose next request has the highest priority first.
+    PriorityMask = 0x0060,
+    PriorityShift = 5,
+    // Flags of a DataMessage: the index of the array that the chunk belongs
+    // to, and the end of the chunks answering a FetchMessage.  The images
+    // answering a SweepMessage use them for the index of the view.
+    DataIndexMask = 0x0FFF,
+    EndOfDataFlag = 0x1000,
+    CancelledFlag = 0x2000,
+    // Set on any message whose payload is compressed with qCompress(), once
+    // compression has been negotiated with a ConfigureMessage.
+    CompressedFlag = 0x8000
+    };
+
+  pqSocketMessageHeader(quint32 requestId=0, quint16 type=0, quint16 flags=0)
+    : PayloadSize(0), RequestId(requestId), Type(type), Flags(flags) {}
+
+  void decode(const char* data)
+    {
+    const uchar* bytes = reinterpret_cast<const uchar*>(data);
+    this->PayloadSize = qFromBigEndian<quint32>(bytes);
+    this->RequestId = qFromBigEndian<quint32>(bytes + 4);
+    this->Type = qFromBigEndian<quint16>(bytes + 8);
+    this->Flags = qFromBigEndian<quint16>(bytes + 10);
+    }
+
+  void encode(char* data) const
+    {
+    uchar* bytes = reinterpret_cast<uchar*>(data);
+    qToBigEndian<quint32>(this->PayloadSize, bytes);
+    qToBigEndian<quint32>(this->RequestId, bytes + 4);
+    qToBigEndian<quint16>(this->Type, bytes + 8);
+    qToBigEndian<quint16>(this->Flags, bytes + 10);
+    }
+
+  quint32 PayloadSize;
+  quint32 RequestId;
+  quint16 Type;
+  quint16 Flags;
+};
+
+// Quotes text as a JSON string, for the replies built in C++.  Control
+// characters without a short escape are written as \u00XX.
+inline QString pqSocketJSONString(const QString& text)
+{
+  QString escaped;
+  escaped.reserve(text.size() + 2);
+  escaped += '"';
+  for (int i = 0; i < text.size(); ++i)
+    {
+    QChar c = text[i];
+    switch (c.unicode())
+      {
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      case '\r':
+        escaped += "\\r";
+        break;
+      case '\t':
+        escaped += "\\t";
+        break;
+      default:
+        if (c.unicode() < 0x20)
+          {
+          escaped += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+          }
+        else
+          {
+          escaped += c;
+          }
+        break;
+      }
+    }
+  escaped += '"';
+  return escaped;
+}
+
+#endif
@@ -0,0 +1,280 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketReceiveBuffer.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketReceiveBuffer.h"
+
+#include <QIODevice>
+#include <QtEndian>
+
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+pqSocketReceiveBuffer::pqSocketReceiveBuffer()
+{
+  this->HeaderSize = 0;
+  this->MaximumPayloadSize = 256*1024*1024;
+  this->clear();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::setHeaderSize(int size)
+{
+  Q_ASSERT(size == 0 || size >= 4);
+  this->HeaderSize = size;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::clear()
+{
+  this->Begin = 0;
+  this->End = 0;
+  this->ScanOffset = 0;
+  this->Valid = true;
+  this->BytesReceived = 0;
+  this->Frames.clear();
+  this->Popped.clear();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::reserve(int bytes)
+{
+  if (this->End + bytes <= this->Buffer.size())
+    {
+    return;
+    }
+
+  // Move the unconsumed bytes to the front, growing the block only when
+  // compacting alone does not leave enough room.
+  int used = this->End - this->Begin;
+  if (used && this->Begin)
+    {
+    char* data = this->Buffer.data();
+    memmove(data, data + this->Begin, used);
+    }
+  this->ScanOffset -= this->Begin;
+  for (int i = 0; i < this->Frames.size(); ++i)
+    {
+    this->Frames[i].Offset -= this->Begin;
+    }
+  this->Begin = 0;
+  this->End = used;
+
+  if (used + bytes > this->Buffer.size())
+    {
+    this->Buffer.resize(qMax(used + bytes, 2*this->Buffer.size()));
+    }
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketReceiveBuffer::peekPayloadSize(int offset) const
+{
+  if (this->End - offset < this->HeaderSize)
+    {
+    return -1;
+    }
+
+  quint32 size = qFromBigEndian<quint32>(
+    reinterpret_cast<const uchar*>(this->Buffer.constData() + offset));
+  if (size > static_cast<quint32>(this->MaximumPayloadSize))
+    {
+    return -2;
+    }
+  return static_cast<int>(size);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::scanFrames(qint64 arrivalTime)
+{
+  if (!this->HeaderSize)
+    {
+    // Without framing everything buffered is one message.
+    if (this->Frames.isEmpty() && this->End > this->Begin)
+      {
+      pqFrame frame = {this->Begin, 0, arrivalTime, false, QByteArray()};
+      this->Frames.enqueue(frame);
+      }
+    this->ScanOffset = this->End;
+    return;
+    }
+
+  while (this->Valid)
+    {
+    int payloadSize = this->peekPayloadSize(this->ScanOffset);
+    if (payloadSize == -2)
+      {
+      this->Valid = false;
+      }
+    if (payloadSize < 0 || this->End - this->ScanOffset < this->HeaderSize + payloadSize)
+      {
+      break;
+      }
+
+    pqFrame frame = {this->ScanOffset, payloadSize, arrivalTime, false, QByteArray()};
+    this->Frames.enqueue(frame);
+    this->ScanOffset += this->HeaderSize + payloadSize;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketReceiveBuffer::readFrom(QIODevice* device, qint64 arrivalTime)
+{
+  if (this->Begin == this->End)
+    {
+    this->Begin = 0;
+    this->End = 0;
+    this->ScanOffset = 0;
+    }
+
+  // readyRead is not emitted again for data the device has already buffered,
+  // so everything available has to be taken now.
+  qint64 available;
+  while (this->Valid && (available = device->bytesAvailable()) > 0)
+    {
+    // When the header of a partially received frame is already here, make
+    // room for the whole frame now so that its remaining pieces never
+    // trigger another reallocation.
+    int wanted = static_cast<int>(qMin<qint64>(available, 64*1024*1024));
+    if (this->HeaderSize)
+      {
+      int payloadSize = this->peekPayloadSize(this->ScanOffset);
+      if (payloadSize >= 0)
+        {
+        wanted = qMax(wanted,
+          this->HeaderSize + payloadSize - (this->End - this->ScanOffset));
+        }
+      }
+    this->reserve(wanted);
+
+    qint64 bytesRead = device->read(this->Buffer.data() + this->End,
+                                    this->Buffer.size() - this->End);
+    if (bytesRead <= 0)
+      {
+      break;
+      }
+    this->End += static_cast<int>(bytesRead);
+    this->BytesReceived += bytesRead;
+    this->scanFrames(arrivalTime);
+    }
+
+  return this->Valid;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::appendFrame(const QByteArray& frame, qint64 arrivalTime)
+{
+  Q_ASSERT(frame.size() >= this->HeaderSize);
+  pqFrame appended = {0, frame.size() - this->HeaderSize, arrivalTime, false, frame};
+  this->Frames.enqueue(appended);
+  this->BytesReceived += frame.size();
+}
+
+//-----------------------------------------------------------------------------
+const char* pqSocketReceiveBuffer::frameStart(const pqFrame& frame) const
+{
+  if (!frame.Data.isNull())
+    {
+    return frame.Data.constData();
+    }
+  return this->Buffer.constData() + frame.Offset;
+}
+
+//-----------------------------------------------------------------------------
+const char* pqSocketReceiveBuffer::header() const
+{
+  return this->frameStart(this->Frames.head());
+}
+
+//-----------------------------------------------------------------------------
+const char* pqSocketReceiveBuffer::payload() const
+{
+  return this->frameStart(this->Frames.head()) + this->HeaderSize;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketReceiveBuffer::payloadSize() const
+{
+  const pqFrame& frame = this->Frames.head();
+  if (!this->HeaderSize && frame.Data.isNull())
+    {
+    return this->End - this->Begin;
+    }
+  return frame.PayloadSize;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketReceiveBuffer::arrivalTime() const
+{
+  return this->Frames.head().ArrivalTime;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketReceiveBuffer::isDiscarded() const
+{
+  return this->Frames.head().Discarded;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::popFrame()
+{
+  Q_ASSERT(this->hasFrame());
+  if (this->Frames.head().Data.isNull())
+    {
+    this->Begin += this->HeaderSize + this->payloadSize();
+    this->Popped.clear();
+    }
+  else
+    {
+    this->Popped = this->Frames.head().Data;
+    }
+  this->Frames.dequeue();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::discardFrames(int first)
+{
+  for (int i = qMax(first, 0); i < this->Frames.size(); ++i)
+    {
+    this->Frames[i].Discarded = true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketReceiveBuffer::discardFrame(int index)
+{
+  this->Frames[index].Discarded = true;
+}
+
+//-----------------------------------------------------------------------------
+const char* pqSocketReceiveBuffer::frameHeader(int index) const
+{
+  return this->frameStart(this->Frames[index]);
+}
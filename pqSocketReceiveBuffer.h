@@ -0,0 +1,134 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketReceiveBuffer.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketReceiveBuffer_h
+#define _pqSocketReceiveBuffer_h
+
+#include <QByteArray>
+#include <QQueue>
+
+class QIODevice;
+
+// Incremental receive buffer for a single connection.  Bytes are read from
+// the device straight into a reusable block of memory and complete frames are
+// handed out as pointers into that block, so a message is never copied
+// between arriving on the socket and being consumed.
+//
+// Each frame starts with a header whose first four bytes hold the payload
+// length as a big-endian unsigned integer.  A header size of zero disables
+// framing: everything received so far is returned as a single frame.
+//
+// Frames that were already split off elsewhere, by the network thread, are
+// queued with appendFrame() and handed out from their own QByteArray.
+class pqSocketReceiveBuffer
+{
+public:
+
+  pqSocketReceiveBuffer();
+
+  void setHeaderSize(int size);
+  int headerSize() const {return this->HeaderSize;}
+
+  void setMaximumPayloadSize(int size) {this->MaximumPayloadSize = size;}
+  int maximumPayloadSize() const {return this->MaximumPayloadSize;}
+
+  // Appends all bytes available on the device and stamps the frames they
+  // complete with the given arrival time.  Returns false if the stream
+  // announced a payload larger than the maximum payload size.  Pointers
+  // returned by header() and payload() are invalidated by this call.
+  bool readFrom(QIODevice* device, qint64 arrivalTime=0);
+
+  // Queues a complete frame, header included, without copying it.
+  void appendFrame(const QByteArray& frame, qint64 arrivalTime=0);
+
+  // False once a frame announces an oversized payload.
+  bool isValid() const {return this->Valid;}
+
+  // Complete frames waiting to be popped.  The accessors below refer to the
+  // oldest one.
+  int frameCount() const {return this->Frames.size();}
+  bool hasFrame() const {return !this->Frames.isEmpty();}
+  const char* header() const;
+  const char* payload() const;
+  int payloadSize() const;
+  qint64 arrivalTime() const;
+  bool isDiscarded() const;
+
+  // The header and payload of the popped frame stay valid until the next
+  // call that changes the buffer.
+  void popFrame();
+
+  // Marks all frames from the given position on as discarded, the owner
+  // pops them without using their payload.
+  void discardFrames(int first);
+  void discardFrame(int index);
+
+  // Header of any complete frame, the oldest one being at position 0.
+  const char* frameHeader(int index) const;
+
+  void clear();
+
+  int bytesBuffered() const {return this->End - this->Begin;}
+  quint64 bytesReceived() const {return this->BytesReceived;}
+  int capacity() const {return this->Buffer.size();}
+
+protected:
+
+  void reserve(int bytes);
+  int peekPayloadSize(int offset) const;
+  void scanFrames(qint64 arrivalTime);
+
+  // Offset is where the header starts in Buffer, it moves with the bytes
+  // when the buffer is compacted.  Appended frames are in Data instead.
+  struct pqFrame
+    {
+    int Offset;
+    int PayloadSize;
+    qint64 ArrivalTime;
+    bool Discarded;
+    QByteArray Data;
+    };
+
+  const char* frameStart(const pqFrame& frame) const;
+
+  QByteArray Buffer;
+  int Begin;
+  int End;
+  int ScanOffset;
+  int HeaderSize;
+  int MaximumPayloadSize;
+  bool Valid;
+  quint64 BytesReceived;
+  QQueue<pqFrame> Frames;
+  QByteArray Popped;
+};
+
+#endif
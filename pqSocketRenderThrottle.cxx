@@ -0,0 +1,229 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketRenderThrottle.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketRenderThrottle.h"
+
+#include <pqView.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QPointer>
+#include <QTimer>
+
+//-----------------------------------------------------------------------------
+class pqSocketRenderThrottle::pqInternal
+{
+public:
+
+  pqInternal()
+    {
+    this->Requested = 0;
+    this->Rendered = 0;
+    this->Clock.start();
+    }
+
+  // Time at which each pending view is due, and time of the last render of
+  // every view that was rendered, in milliseconds.
+  QMap<pqView*, qint64> Pending;
+  QMap<pqView*, qint64> LastRender;
+  QTimer Timer;
+  QElapsedTimer Clock;
+  quint64 Requested;
+  quint64 Rendered;
+};
+
+namespace
+{
+  pqSocketRenderThrottle* Instance = 0;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketRenderThrottle* pqSocketRenderThrottle::instance()
+{
+  if (!Instance)
+    {
+    Instance = new pqSocketRenderThrottle(QCoreApplication::instance());
+    }
+  return Instance;
+}
+
+//-----------------------------------------------------------------------------
+pqSocketRenderThrottle::pqSocketRenderThrottle(QObject* parent) : QObject(parent)
+{
+  this->Internal = new pqInternal;
+  this->Internal->Timer.setSingleShot(true);
+  this->connect(&this->Internal->Timer, SIGNAL(timeout()), SLOT(flush()));
+}
+
+//-----------------------------------------------------------------------------
+pqSocketRenderThrottle::~pqSocketRenderThrottle()
+{
+  Instance = 0;
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketRenderThrottle::parseSetting(const QString& value, int& interval)
+{
+  if (value == "immediate")
+    {
+    interval = ImmediateRender;
+    return true;
+    }
+  if (value == "batch")
+    {
+    interval = 0;
+    return true;
+    }
+  bool ok;
+  int milliseconds = value.toInt(&ok);
+  if (!ok || milliseconds < 0)
+    {
+    return false;
+    }
+  interval = milliseconds;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketRenderThrottle::requestRender(pqView* view, int interval)
+{
+  this->Internal->Requested++;
+  if (interval == ImmediateRender)
+    {
+    // pqView::render() already merges the renders of one event loop turn.
+    this->Internal->Rendered++;
+    view->render();
+    return;
+    }
+  if (this->Internal->Pending.contains(view))
+    {
+    return;
+    }
+
+  if (!this->Internal->LastRender.contains(view))
+    {
+    this->connect(view, SIGNAL(destroyed(QObject*)), SLOT(onViewDestroyed(QObject*)),
+                  Qt::UniqueConnection);
+    }
+  qint64 now = this->Internal->Clock.elapsed();
+  qint64 due = this->Internal->LastRender.contains(view)
+    ? qMax(now, this->Internal->LastRender[view] + interval) : now;
+  this->Internal->Pending.insert(view, due);
+  this->scheduleFlush();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketRenderThrottle::forceRender(pqView* view)
+{
+  this->Internal->Requested++;
+  this->Internal->Rendered++;
+  this->Internal->Pending.remove(view);
+  this->connect(view, SIGNAL(destroyed(QObject*)), SLOT(onViewDestroyed(QObject*)),
+                Qt::UniqueConnection);
+  view->forceRender();
+  this->Internal->LastRender[view] = this->Internal->Clock.elapsed();
+  this->scheduleFlush();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketRenderThrottle::flush()
+{
+  // Rendering may process events that request more renders, so the due
+  // views are taken out of the map first.
+  qint64 now = this->Internal->Clock.elapsed();
+  QList<QPointer<pqView> > due;
+  QMap<pqView*, qint64>::iterator iter = this->Internal->Pending.begin();
+  while (iter != this->Internal->Pending.end())
+    {
+    if (iter.value() <= now)
+      {
+      due.append(iter.key());
+      iter = this->Internal->Pending.erase(iter);
+      }
+    else
+      {
+      ++iter;
+      }
+    }
+
+  foreach (pqView* view, due)
+    {
+    if (!view)
+      {
+      continue;
+      }
+    this->Internal->Rendered++;
+    view->forceRender();
+    this->Internal->LastRender[view] = this->Internal->Clock.elapsed();
+    }
+  this->scheduleFlush();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketRenderThrottle::scheduleFlush()
+{
+  if (this->Internal->Pending.isEmpty())
+    {
+    this->Internal->Timer.stop();
+    return;
+    }
+
+  qint64 due = this->Internal->Pending.begin().value();
+  foreach (qint64 time, this->Internal->Pending)
+    {
+    due = qMin(due, time);
+    }
+  this->Internal->Timer.start(static_cast<int>(qMax<qint64>(0, due - this->Internal->Clock.elapsed())));
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketRenderThrottle::onViewDestroyed(QObject* object)
+{
+  pqView* view = static_cast<pqView*>(object);
+  this->Internal->Pending.remove(view);
+  this->Internal->LastRender.remove(view);
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqSocketRenderThrottle::requestedRenders() const
+{
+  return this->Internal->Requested;
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqSocketRenderThrottle::renders() const
+{
+  return this->Internal->Rendered;
+}
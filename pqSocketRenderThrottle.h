@@ -0,0 +1,93 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketRenderThrottle.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketRenderThrottle_h
+#define _pqSocketRenderThrottle_h
+
+#include <QObject>
+
+class pqView;
+
+// Merges the renders requested by remote commands.  A deferred render of a
+// view is done once, after the scheduler's current turn of messages or, with
+// an interval, no sooner than that many milliseconds after the previous
+// render of the view.  All connections share one throttle since they share
+// the views.
+class pqSocketRenderThrottle : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  // The render setting of a connection is an interval in milliseconds,
+  // ImmediateRender for no throttling and 0 for one render per turn.
+  enum
+    {
+    ImmediateRender = -1
+    };
+
+  static pqSocketRenderThrottle* instance();
+
+  // Parses 'immediate', 'batch' or a number of milliseconds.
+  static bool parseSetting(const QString& value, int& interval);
+
+  // Schedules a render of the view, or renders it right away with
+  // ImmediateRender.
+  void requestRender(pqView* view, int interval);
+
+  // Renders the view synchronously and cancels its pending render.
+  void forceRender(pqView* view);
+
+  quint64 requestedRenders() const;
+  quint64 renders() const;
+
+public slots:
+
+  // Renders the pending views that are due.
+  void flush();
+
+protected slots:
+
+  void onViewDestroyed(QObject* view);
+
+protected:
+
+  pqSocketRenderThrottle(QObject* parent);
+  virtual ~pqSocketRenderThrottle();
+
+  void scheduleFlush();
+
+private:
+  class pqInternal;
+  pqInternal* Internal;
+};
+
+#endif
@@ -0,0 +1,426 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketScheduler.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketScheduler.h"
+#include "pqSocketHandler.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+
+//-----------------------------------------------------------------------------
+class pqSocketScheduler::pqInternal
+{
+public:
+
+  pqInternal()
+    {
+    this->Next = 0;
+    this->Processing = false;
+    this->Paused = false;
+    this->TimeBudget = 20;
+    this->Batching = true;
+    this->MaximumBatchSize = 100;
+    this->MaximumQueueDepth = 1000;
+    this->Policy = PauseReading;
+    }
+
+  void resetStatistics()
+    {
+    this->Executed = 0;
+    this->Rejected = 0;
+    this->Batches = 0;
+    this->MaximumDepth = 0;
+    this->WaitTotal = 0;
+    this->WaitMaximum = 0;
+    this->ExecuteTotal = 0;
+    this->ExecuteMaximum = 0;
+    }
+
+  // Priority of the most urgent next message, -1 if none is pending.
+  int highestPriority() const
+    {
+    int priority = -1;
+    foreach (pqSocketHandler* handler, this->Handlers)
+      {
+      if (handler->hasPendingMessage())
+        {
+        priority = qMax(priority, handler->nextMessagePriority());
+        }
+      }
+    return priority;
+    }
+
+  QList<pqSocketHandler*> Handlers;
+  QTimer Timer;
+  int Next;
+  bool Processing;
+  bool Paused;
+
+  int TimeBudget;
+  bool Batching;
+  int MaximumBatchSize;
+  int MaximumQueueDepth;
+  BackpressurePolicy Policy;
+
+  quint64 Executed;
+  quint64 Rejected;
+  quint64 Batches;
+  int MaximumDepth;
+  qint64 WaitTotal;
+  qint64 WaitMaximum;
+  qint64 ExecuteTotal;
+  qint64 ExecuteMaximum;
+};
+
+//-----------------------------------------------------------------------------
+pqSocketScheduler::pqSocketScheduler(QObject* parent) : QObject(parent)
+{
+  this->Internal = new pqInternal;
+  this->Internal->resetStatistics();
+  this->Internal->Timer.setSingleShot(true);
+  this->Internal->Timer.setInterval(0);
+  this->connect(&this->Internal->Timer, SIGNAL(timeout()), SLOT(processMessages()));
+}
+
+//-----------------------------------------------------------------------------
+pqSocketScheduler::~pqSocketScheduler()
+{
+  delete this->Internal;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::addHandler(pqSocketHandler* handler)
+{
+  this->Internal->Handlers.append(handler);
+  handler->setReadingPaused(this->Internal->Paused);
+  this->connect(handler, SIGNAL(outputDrained()), SLOT(schedule()));
+  this->connect(handler, SIGNAL(messagesReleased()), SLOT(schedule()));
+  if (handler->hasPendingMessage())
+    {
+    this->schedule();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::removeHandler(pqSocketHandler* handler)
+{
+  this->Internal->Handlers.removeAll(handler);
+  this->disconnect(handler, 0, this, 0);
+  this->updateBackpressure();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::readReady(pqSocketHandler* handler)
+{
+  int before = handler->pendingMessageCount();
+  handler->onSocketReadReady();
+  int received = handler->pendingMessageCount() - before;
+  if (received <= 0)
+    {
+    return;
+    }
+
+  if (this->Internal->Policy == RejectMessages)
+    {
+    int excess = this->queueDepth() - this->Internal->MaximumQueueDepth;
+    if (excess > 0)
+      {
+      int rejected = qMin(excess, received);
+      handler->discardNewestMessages(rejected);
+      this->Internal->Rejected += rejected;
+      }
+    }
+
+  this->updateBackpressure();
+  this->schedule();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::schedule()
+{
+  if (!this->Internal->Timer.isActive() && !this->Internal->Processing)
+    {
+    this->Internal->Timer.start();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::updateBackpressure()
+{
+  int depth = this->queueDepth();
+  this->Internal->MaximumDepth = qMax(this->Internal->MaximumDepth, depth);
+
+  // Resume at half the limit so that reading does not flip on and off with
+  // every message.
+  bool paused = this->Internal->Paused;
+  if (this->Internal->Policy != PauseReading)
+    {
+    paused = false;
+    }
+  else if (depth >= this->Internal->MaximumQueueDepth)
+    {
+    paused = true;
+    }
+  else if (depth <= this->Internal->MaximumQueueDepth / 2)
+    {
+    paused = false;
+    }
+
+  if (paused != this->Internal->Paused)
+    {
+    this->Internal->Paused = paused;
+    foreach (pqSocketHandler* handler, this->Internal->Handlers)
+      {
+      handler->setReadingPaused(paused);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::processMessages()
+{
+  // A message that spins the event loop can bring us back here, the outer
+  // call takes care of whatever arrived in the meantime.
+  if (this->Internal->Processing)
+    {
+    return;
+    }
+  this->Internal->Processing = true;
+
+  QElapsedTimer slice;
+  slice.start();
+  QList<QPointer<pqSocketHandler> > batch;
+  int executed = 0;
+
+  // Serve the handlers in turn, one message each, continuing where the
+  // previous turn stopped.  Only the handlers whose next message has the
+  // highest priority take part.  The loop ends when the time budget or the
+  // batch size is used up or nothing is left to do.
+  while (slice.elapsed() < this->Internal->TimeBudget
+         && (!this->Internal->Batching || executed < this->Internal->MaximumBatchSize))
+    {
+    int priority = this->Internal->highestPriority();
+    if (priority < 0)
+      {
+      break;
+      }
+    QPointer<pqSocketHandler> handler;
+    do
+      {
+      this->Internal->Next %= this->Internal->Handlers.size();
+      handler = this->Internal->Handlers[this->Internal->Next++];
+      }
+    while (!handler->hasPendingMessage() || handler->nextMessagePriority() != priority);
+
+    if (this->Internal->Batching && !batch.contains(handler))
+      {
+      batch.append(handler);
+      handler->beginBatch();
+      }
+
+    qint64 start = pqSocketHandler::currentTime();
+    qint64 wait = start - handler->nextMessageArrivalTime();
+    handler->processNextMessage();
+    qint64 execute = pqSocketHandler::currentTime() - start;
+
+    this->Internal->Executed++;
+    executed++;
+    this->Internal->WaitTotal += wait;
+    this->Internal->WaitMaximum = qMax(this->Internal->WaitMaximum, wait);
+    this->Internal->ExecuteTotal += execute;
+    this->Internal->ExecuteMaximum = qMax(this->Internal->ExecuteMaximum, execute);
+
+    // The socket may have been closed while the message was running, the
+    // handler was kept alive until now.
+    if (handler && !handler->socket())
+      {
+      handler->deleteLater();
+      }
+    }
+
+  for (int i = batch.size() - 1; i >= 0; --i)
+    {
+    if (batch[i])
+      {
+      batch[i]->endBatch();
+      }
+    }
+  if (!batch.isEmpty())
+    {
+    this->Internal->Batches++;
+    }
+
+  this->Internal->Processing = false;
+
+  // Messages of blocked connections, and of connections holding them during
+  // a sweep, are left for outputDrained() and messagesReleased() to
+  // schedule, otherwise the timer would spin until they can run.
+  this->updateBackpressure();
+  if (this->Internal->highestPriority() >= 0)
+    {
+    this->schedule();
+    }
+
+  emit this->statisticsChanged();
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketScheduler::queueDepth() const
+{
+  int depth = 0;
+  foreach (pqSocketHandler* handler, this->Internal->Handlers)
+    {
+    depth += handler->pendingMessageCount();
+    }
+  return depth;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::setTimeBudget(int msecs)
+{
+  this->Internal->TimeBudget = msecs;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketScheduler::timeBudget() const
+{
+  return this->Internal->TimeBudget;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::setBatchingEnabled(bool enabled)
+{
+  this->Internal->Batching = enabled;
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketScheduler::batchingEnabled() const
+{
+  return this->Internal->Batching;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::setMaximumBatchSize(int messages)
+{
+  this->Internal->MaximumBatchSize = messages;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketScheduler::maximumBatchSize() const
+{
+  return this->Internal->MaximumBatchSize;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::setMaximumQueueDepth(int messages)
+{
+  this->Internal->MaximumQueueDepth = messages;
+  this->updateBackpressure();
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketScheduler::maximumQueueDepth() const
+{
+  return this->Internal->MaximumQueueDepth;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::setBackpressurePolicy(BackpressurePolicy policy)
+{
+  this->Internal->Policy = policy;
+  this->updateBackpressure();
+}
+
+//-----------------------------------------------------------------------------
+pqSocketScheduler::BackpressurePolicy pqSocketScheduler::backpressurePolicy() const
+{
+  return this->Internal->Policy;
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqSocketScheduler::executedMessages() const
+{
+  return this->Internal->Executed;
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqSocketScheduler::rejectedMessages() const
+{
+  return this->Internal->Rejected;
+}
+
+//-----------------------------------------------------------------------------
+quint64 pqSocketScheduler::batches() const
+{
+  return this->Internal->Batches;
+}
+
+//-----------------------------------------------------------------------------
+int pqSocketScheduler::maximumObservedQueueDepth() const
+{
+  return this->Internal->MaximumDepth;
+}
+
+//-----------------------------------------------------------------------------
+double pqSocketScheduler::averageWaitTime() const
+{
+  return this->Internal->Executed ?
+    this->Internal->WaitTotal / (1000.0 * this->Internal->Executed) : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+double pqSocketScheduler::maximumWaitTime() const
+{
+  return this->Internal->WaitMaximum / 1000.0;
+}
+
+//-----------------------------------------------------------------------------
+double pqSocketScheduler::averageExecutionTime() const
+{
+  return this->Internal->Executed ?
+    this->Internal->ExecuteTotal / (1000.0 * this->Internal->Executed) : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+double pqSocketScheduler::maximumExecutionTime() const
+{
+  return this->Internal->ExecuteMaximum / 1000.0;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketScheduler::resetStatistics()
+{
+  this->Internal->resetStatistics();
+  emit this->statisticsChanged();
+}
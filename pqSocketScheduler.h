@@ -0,0 +1,121 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketScheduler.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketScheduler_h
+#define _pqSocketScheduler_h
+
+#include <QObject>
+
+class pqSocketHandler;
+
+// Executes the messages received by all socket handlers from the Qt event
+// loop.  Handlers are served round-robin, one message at a time, for at most
+// timeBudget() milliseconds per event loop turn so that a flood of messages
+// cannot starve repaints and user input.  A handler whose next message has a
+// higher priority goes ahead of the others; each handler still executes its
+// own messages in order.  When more than
+// maximumQueueDepth() messages are waiting, the backpressure policy either
+// stops reading from the sockets or rejects new messages.
+//
+// With batching enabled, the messages executed in one turn form a batch:
+// every handler involved gets beginBatch() before its first message and
+// endBatch() after the turn, and a turn also ends after
+// maximumBatchSize() messages.
+class pqSocketScheduler : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  enum BackpressurePolicy
+    {
+    PauseReading,
+    RejectMessages
+    };
+
+  pqSocketScheduler(QObject* parent);
+  virtual ~pqSocketScheduler();
+
+  void addHandler(pqSocketHandler* handler);
+  void removeHandler(pqSocketHandler* handler);
+
+  // Lets the handler read what arrived on its socket and schedules the
+  // execution of the complete messages.
+  void readReady(pqSocketHandler* handler);
+
+  void setTimeBudget(int msecs);
+  int timeBudget() const;
+
+  void setBatchingEnabled(bool enabled);
+  bool batchingEnabled() const;
+
+  void setMaximumBatchSize(int messages);
+  int maximumBatchSize() const;
+
+  void setMaximumQueueDepth(int messages);
+  int maximumQueueDepth() const;
+
+  void setBackpressurePolicy(BackpressurePolicy policy);
+  BackpressurePolicy backpressurePolicy() const;
+
+  // Number of messages waiting to be executed.
+  int queueDepth() const;
+
+  // Statistics since the last reset, times are in milliseconds.
+  quint64 executedMessages() const;
+  quint64 rejectedMessages() const;
+  quint64 batches() const;
+  int maximumObservedQueueDepth() const;
+  double averageWaitTime() const;
+  double maximumWaitTime() const;
+  double averageExecutionTime() const;
+  double maximumExecutionTime() const;
+  void resetStatistics();
+
+signals:
+
+  void statisticsChanged();
+
+protected slots:
+
+  void processMessages();
+  void schedule();
+
+protected:
+
+  void updateBackpressure();
+
+private:
+  class pqInternal;
+  pqInternal* Internal;
+};
+
+#endif
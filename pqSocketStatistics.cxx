@@ -0,0 +1,304 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketStatistics.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+
+#include "pqSocketStatistics.h"
+#include "pqSocketMessage.h"
+
+#include <QStringList>
+
+#include <string.h>
+
+namespace
+{
+  QList<pqSocketStatistics*> OpenStatistics;
+
+  // CSV quotes by doubling them, not with backslashes.
+  QString csvString(QString text)
+    {
+    return QString("\"%1\"").arg(text.replace('"', "\"\""));
+    }
+
+  int bucketIndex(qint64 value)
+    {
+    if (value < 8)
+      {
+      return static_cast<int>(qMax<qint64>(value, 0));
+      }
+    int bit = 3;
+    while (bit < 62 && (value >> (bit + 1)))
+      {
+      ++bit;
+      }
+    return (bit - 2)*8 + static_cast<int>((value >> (bit - 3)) & 7);
+    }
+
+  qint64 bucketUpperBound(int index)
+    {
+    if (index < 8)
+      {
+      return index;
+      }
+    int bit = index/8 + 2;
+    qint64 step = Q_INT64_C(1) << (bit - 3);
+    return (8 + index%8)*step + step - 1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketHistogram::pqSocketHistogram()
+{
+  this->reset();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHistogram::reset()
+{
+  memset(this->Buckets, 0, sizeof(this->Buckets));
+  this->Count = 0;
+  this->Total = 0;
+  this->Maximum = 0;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHistogram::add(qint64 value)
+{
+  this->Buckets[bucketIndex(value)]++;
+  this->Count++;
+  this->Total += value;
+  this->Maximum = qMax(this->Maximum, value);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketHistogram::merge(const pqSocketHistogram& other)
+{
+  for (int i = 0; i < BucketCount; ++i)
+    {
+    this->Buckets[i] += other.Buckets[i];
+    }
+  this->Count += other.Count;
+  this->Total += other.Total;
+  this->Maximum = qMax(this->Maximum, other.Maximum);
+}
+
+//-----------------------------------------------------------------------------
+double pqSocketHistogram::average() const
+{
+  return this->Count ? static_cast<double>(this->Total) / this->Count : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+qint64 pqSocketHistogram::percentile(double fraction) const
+{
+  quint64 rank = static_cast<quint64>(fraction * this->Count + 0.5);
+  quint64 seen = 0;
+  for (int i = 0; i < BucketCount; ++i)
+    {
+    seen += this->Buckets[i];
+    if (seen && seen >= rank)
+      {
+      return qMin(bucketUpperBound(i), this->Maximum);
+      }
+    }
+  return this->Maximum;
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketHistogram::toJSON() const
+{
+  return QString("{\"count\": %1, \"average\": %2, \"p50\": %3, \"p99\": %4, \"max\": %5}")
+    .arg(this->Count).arg(this->average(), 0, 'f', 1)
+    .arg(this->percentile(0.5)).arg(this->percentile(0.99)).arg(this->Maximum);
+}
+
+//-----------------------------------------------------------------------------
+pqSocketStatistics::pqSocketStatistics()
+{
+  this->Open = false;
+  this->reset();
+}
+
+//-----------------------------------------------------------------------------
+pqSocketStatistics::~pqSocketStatistics()
+{
+  this->setOpen(false);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketStatistics::setOpen(bool open)
+{
+  if (open && !this->Open)
+    {
+    OpenStatistics.append(this);
+    }
+  else if (!open && this->Open)
+    {
+    OpenStatistics.removeAll(this);
+    }
+  this->Open = open;
+}
+
+//-----------------------------------------------------------------------------
+QList<pqSocketStatistics*> pqSocketStatistics::openConnections()
+{
+  return OpenStatistics;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketStatistics::reset()
+{
+  this->BytesReceived = 0;
+  this->BytesSent = 0;
+  this->MessagesReceived = 0;
+  this->MessagesSent = 0;
+  this->MessagesRejected = 0;
+  this->OutputBuffered = 0;
+  this->MaximumOutputBuffered = 0;
+  this->OutputStalls = 0;
+  this->FramesDropped = 0;
+  this->EventsSent = 0;
+  this->EventsCoalesced = 0;
+  this->RequestsCancelled = 0;
+  this->CompressedBytesIn = 0;
+  this->UncompressedBytesIn = 0;
+  this->CompressedBytesOut = 0;
+  this->UncompressedBytesOut = 0;
+  this->CompressionTime = 0;
+  this->CodeCacheHits = 0;
+  this->CodeCacheMisses = 0;
+  this->QueueWait.reset();
+  this->Compile.reset();
+  this->Execute.reset();
+  this->Latency.reset();
+  this->ReplySize.reset();
+  this->SlowestMessage.clear();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketStatistics::addMessage(qint64 wait, qint64 execute, const char* text, int length)
+{
+  if (execute >= this->Execute.maximum() && text)
+    {
+    this->SlowestMessage = QString::fromUtf8(text, qMin(length, 80)).simplified();
+    }
+  this->MessagesReceived++;
+  this->QueueWait.add(wait);
+  this->Execute.add(execute);
+  this->Latency.add(wait + execute);
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketStatistics::toJSON() const
+{
+  QStringList fields;
+  fields << QString("\"name\": %1").arg(pqSocketJSONString(this->Name))
+         << QString("\"bytes_received\": %1").arg(this->BytesReceived)
+         << QString("\"bytes_sent\": %1").arg(this->BytesSent)
+         << QString("\"messages_received\": %1").arg(this->MessagesReceived)
+         << QString("\"messages_sent\": %1").arg(this->MessagesSent)
+         << QString("\"messages_rejected\": %1").arg(this->MessagesRejected)
+         << QString("\"output_buffered\": %1").arg(this->OutputBuffered)
+         << QString("\"output_buffered_max\": %1").arg(this->MaximumOutputBuffered)
+         << QString("\"output_stalls\": %1").arg(this->OutputStalls)
+         << QString("\"frames_dropped\": %1").arg(this->FramesDropped)
+         << QString("\"events_sent\": %1").arg(this->EventsSent)
+         << QString("\"events_coalesced\": %1").arg(this->EventsCoalesced)
+         << QString("\"requests_cancelled\": %1").arg(this->RequestsCancelled)
+         << QString("\"compressed_bytes_in\": %1").arg(this->CompressedBytesIn)
+         << QString("\"uncompressed_bytes_in\": %1").arg(this->UncompressedBytesIn)
+         << QString("\"compressed_bytes_out\": %1").arg(this->CompressedBytesOut)
+         << QString("\"uncompressed_bytes_out\": %1").arg(this->UncompressedBytesOut)
+         << QString("\"compression_us\": %1").arg(this->CompressionTime)
+         << QString("\"code_cache_hits\": %1").arg(this->CodeCacheHits)
+         << QString("\"code_cache_misses\": %1").arg(this->CodeCacheMisses)
+         << QString("\"queue_wait_us\": %1").arg(this->QueueWait.toJSON())
+         << QString("\"compile_us\": %1").arg(this->Compile.toJSON())
+         << QString("\"execute_us\": %1").arg(this->Execute.toJSON())
+         << QString("\"latency_us\": %1").arg(this->Latency.toJSON())
+         << QString("\"reply_bytes\": %1").arg(this->ReplySize.toJSON())
+         << QString("\"slowest_message\": %1").arg(pqSocketJSONString(this->SlowestMessage));
+  return QString("{%1}").arg(fields.join(", "));
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketStatistics::csvHeader()
+{
+  QStringList columns;
+  columns << "name" << "bytes_received" << "bytes_sent" << "messages_received"
+          << "messages_sent" << "messages_rejected" << "output_buffered"
+          << "output_buffered_max" << "output_stalls" << "frames_dropped"
+          << "events_sent" << "events_coalesced" << "requests_cancelled"
+          << "compressed_bytes_in" << "uncompressed_bytes_in" << "compressed_bytes_out"
+          << "uncompressed_bytes_out" << "compression_us" << "code_cache_hits"
+          << "code_cache_misses";
+  const char* histograms[] = {"queue_wait_us", "compile_us", "execute_us", "latency_us",
+                              "reply_bytes"};
+  for (int i = 0; i < 5; ++i)
+    {
+    columns << QString("%1_count").arg(histograms[i]) << QString("%1_average").arg(histograms[i])
+            << QString("%1_p50").arg(histograms[i]) << QString("%1_p99").arg(histograms[i])
+            << QString("%1_max").arg(histograms[i]);
+    }
+  columns << "slowest_message";
+  return columns.join(",");
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketStatistics::toCSV() const
+{
+  QStringList values;
+  values << csvString(this->Name)
+         << QString::number(this->BytesReceived) << QString::number(this->BytesSent)
+         << QString::number(this->MessagesReceived) << QString::number(this->MessagesSent)
+         << QString::number(this->MessagesRejected)
+         << QString::number(this->OutputBuffered) << QString::number(this->MaximumOutputBuffered)
+         << QString::number(this->OutputStalls) << QString::number(this->FramesDropped)
+         << QString::number(this->EventsSent) << QString::number(this->EventsCoalesced)
+         << QString::number(this->RequestsCancelled)
+         << QString::number(this->CompressedBytesIn)
+         << QString::number(this->UncompressedBytesIn)
+         << QString::number(this->CompressedBytesOut)
+         << QString::number(this->UncompressedBytesOut)
+         << QString::number(this->CompressionTime)
+         << QString::number(this->CodeCacheHits) << QString::number(this->CodeCacheMisses);
+  const pqSocketHistogram* histograms[] = {&this->QueueWait, &this->Compile, &this->Execute,
+                                           &this->Latency, &this->ReplySize};
+  for (int i = 0; i < 5; ++i)
+    {
+    values << QString::number(histograms[i]->count())
+           << QString::number(histograms[i]->average(), 'f', 1)
+           << QString::number(histograms[i]->percentile(0.5))
+           << QString::number(histograms[i]->percentile(0.99))
+           << QString::number(histograms[i]->maximum());
+    }
+  values << csvString(this->SlowestMessage);
+  return values.join(",");
+}
@@ -0,0 +1,141 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketStatistics.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketStatistics_h
+#define _pqSocketStatistics_h
+
+#include <QList>
+#include <QString>
+
+// Histogram with logarithmic buckets, eight per power of two, so that
+// percentiles are accurate to about 12% over the whole range of values
+// while adding a value stays cheap.
+class pqSocketHistogram
+{
+public:
+
+  pqSocketHistogram();
+
+  void add(qint64 value);
+  void merge(const pqSocketHistogram& other);
+  void reset();
+
+  quint64 count() const {return this->Count;}
+  qint64 total() const {return this->Total;}
+  qint64 maximum() const {return this->Maximum;}
+  double average() const;
+
+  // Upper bound of the bucket holding the given fraction of the values.
+  qint64 percentile(double fraction) const;
+
+  QString toJSON() const;
+
+private:
+
+  enum
+    {
+    BucketCount = 8*62
+    };
+
+  quint64 Buckets[BucketCount];
+  quint64 Count;
+  qint64 Total;
+  qint64 Maximum;
+};
+
+// Counters and histograms of one connection.  Times are in microseconds and
+// sizes in bytes.  The statistics of all open connections can be listed, for
+// the dock panel and for clients asking over their socket.
+class pqSocketStatistics
+{
+public:
+
+  pqSocketStatistics();
+  ~pqSocketStatistics();
+
+  void setName(const QString& name) {this->Name = name;}
+  const QString& name() const {return this->Name;}
+
+  // Open statistics are listed by openConnections().
+  void setOpen(bool open);
+  static QList<pqSocketStatistics*> openConnections();
+
+  void reset();
+
+  // Records an executed message, keeping the beginning of the slowest one.
+  void addMessage(qint64 wait, qint64 execute, const char* text, int length);
+
+  QString toJSON() const;
+  static QString csvHeader();
+  QString toCSV() const;
+
+  quint64 BytesReceived;
+  quint64 BytesSent;
+  quint64 MessagesReceived;
+  quint64 MessagesSent;
+  quint64 MessagesRejected;
+  // Bytes written to the socket but not yet sent, now and at most, how often
+  // the connection went over its high water mark and how many droppable
+  // frames were skipped because of it.
+  qint64 OutputBuffered;
+  qint64 MaximumOutputBuffered;
+  quint64 OutputStalls;
+  quint64 FramesDropped;
+  // Event notifications pushed to the client, and those merged into a later
+  // one by the rate limit.
+  quint64 EventsSent;
+  quint64 EventsCoalesced;
+  // Requests dropped from the queue or interrupted by a CancelMessage.
+  quint64 RequestsCancelled;
+  // Compressed payloads before and after compression, in both directions,
+  // and the time spent compressing and uncompressing them.
+  quint64 CompressedBytesIn;
+  quint64 UncompressedBytesIn;
+  quint64 CompressedBytesOut;
+  quint64 UncompressedBytesOut;
+  qint64 CompressionTime;
+  // Scripts found in the cache of compiled code and those compiled.
+  quint64 CodeCacheHits;
+  quint64 CodeCacheMisses;
+  pqSocketHistogram QueueWait;
+  pqSocketHistogram Compile;
+  pqSocketHistogram Execute;
+  pqSocketHistogram Latency;
+  pqSocketHistogram ReplySize;
+  QString SlowestMessage;
+
+private:
+
+  QString Name;
+  bool Open;
+};
+
+#endif
@@ -0,0 +1,497 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketSweep.cxx
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#include "pqSocketSweep.h"
+#include "pqSocketHandler.h"
+#include "pqSocketMessage.h"
+#include "pqSocketRenderThrottle.h"
+
+#include <pqActiveObjects.h>
+#include <pqApplicationCore.h>
+#include <pqServer.h>
+#include <pqServerManagerModel.h>
+#include <pqTimeKeeper.h>
+#include <pqView.h>
+
+#include <vtkImageData.h>
+#include <vtkSMViewProxy.h>
+
+#include <QRunnable>
+#include <QThread>
+
+namespace
+{
+  const char* StageNames[] = {"update", "render", "readback", "encode", "send"};
+
+  // Encodes one image read back from a view, with an encoder of its own since
+  // the images of a sweep are full frames.  A job dropped from the pool
+  // before it ran reports an empty image, so the sweep knows when none is
+  // left.
+  class pqEncodeJob : public QRunnable
+  {
+  public:
+
+    pqEncodeJob(QObject* sweep, int index, vtkImageData* image,
+                pqSocketImageEncoder::Codec codec, int quality)
+      {
+      this->Sweep = sweep;
+      this->Index = index;
+      this->Image = image;
+      this->Codec = codec;
+      this->Quality = quality;
+      this->Ran = false;
+      }
+
+    virtual ~pqEncodeJob()
+      {
+      if (this->Image)
+        {
+        this->Image->Delete();
+        }
+      if (!this->Ran)
+        {
+        QMetaObject::invokeMethod(this->Sweep, "onImageEncoded", Qt::QueuedConnection,
+                                  Q_ARG(int, this->Index), Q_ARG(QByteArray, QByteArray()),
+                                  Q_ARG(double, 0.0));
+        }
+      }
+
+    virtual void run()
+      {
+      this->Ran = true;
+      qint64 start = pqSocketHandler::currentTime();
+      QByteArray data;
+      if (this->Image)
+        {
+        pqSocketImageEncoder encoder;
+        encoder.setJPEGQuality(this->Quality);
+        data = encoder.encode(this->Image, this->Codec, false);
+        }
+      double milliseconds = (pqSocketHandler::currentTime() - start) / 1000.0;
+      QMetaObject::invokeMethod(this->Sweep, "onImageEncoded", Qt::QueuedConnection,
+                                Q_ARG(int, this->Index), Q_ARG(QByteArray, data),
+                                Q_ARG(double, milliseconds));
+      }
+
+  private:
+
+    QObject* Sweep;
+    int Index;
+    vtkImageData* Image;
+    pqSocketImageEncoder::Codec Codec;
+    int Quality;
+    bool Ran;
+  };
+
+  QString jsonNumber(double value)
+    {
+    return QString::number(value, 'f', 3);
+    }
+}
+
+//-----------------------------------------------------------------------------
+pqSocketSweep::pqSocketSweep(pqSocketHandler* handler, QObject* parent) : QObject(parent)
+{
+  this->Handler = handler;
+  this->Codec = pqSocketImageEncoder::PNGCodec;
+  this->Quality = pqSocketImageEncoder().jpegQuality();
+  this->Depth = 4;
+  this->OriginalTime = 0;
+  this->Started = false;
+  this->Finished = false;
+  this->Cancelled = false;
+  this->Released = false;
+  this->PendingJobs = 0;
+  this->CapturedFrames = 0;
+  this->EncodedImages = 0;
+  this->SentImages = 0;
+  this->StartTime = 0;
+  this->EndTime = 0;
+  this->BytesSent = 0;
+  for (int i = 0; i < StageCount; ++i)
+    {
+    this->StageTime[i] = 0;
+    }
+  this->Pool.setMaxThreadCount(QThread::idealThreadCount());
+  this->Timer.setSingleShot(true);
+  this->Timer.setInterval(0);
+  this->connect(&this->Timer, SIGNAL(timeout()), SLOT(step()));
+}
+
+//-----------------------------------------------------------------------------
+pqSocketSweep::~pqSocketSweep()
+{
+  this->Pool.clear();
+  this->Pool.waitForDone();
+}
+
+//-----------------------------------------------------------------------------
+bool pqSocketSweep::initialize(const char* payload, int payloadSize, QString& error)
+{
+  pqServer* server = pqActiveObjects::instance().activeServer();
+  this->TimeKeeper = server ? server->getTimeKeeper() : NULL;
+  if (!this->TimeKeeper)
+    {
+    error = "There is no server to sweep.";
+    return false;
+    }
+  QList<double> timesteps = this->TimeKeeper->getTimeSteps();
+  if (timesteps.isEmpty())
+    {
+    error = "There are no timesteps to sweep.";
+    return false;
+    }
+  double start = timesteps.first();
+  double end = timesteps.last();
+  int stride = 1;
+  QString views = "active";
+
+  QStringList lines = QString::fromUtf8(payload, payloadSize).split('\n', QString::SkipEmptyParts);
+  foreach (QString line, lines)
+    {
+    int separator = line.indexOf('=');
+    QString key = line.left(separator).trimmed();
+    QString value = separator < 0 ? QString() : line.mid(separator + 1).trimmed();
+    bool valid = separator >= 0;
+    if (key == "start")
+      {
+      start = value.toDouble(&valid);
+      }
+    else if (key == "end")
+      {
+      end = value.toDouble(&valid);
+      }
+    else if (key == "stride")
+      {
+      stride = value.toInt(&valid);
+      valid = valid && stride > 0;
+      }
+    else if (key == "views")
+      {
+      views = value;
+      }
+    else if (key == "codec")
+      {
+      QStringList codecs = QStringList() << "png" << "jpeg" << "raw";
+      valid = codecs.contains(value);
+      this->Codec = static_cast<pqSocketImageEncoder::Codec>(codecs.indexOf(value));
+      }
+    else if (key == "quality")
+      {
+      this->Quality = value.toInt(&valid);
+      valid = valid && this->Quality > 0 && this->Quality <= 100;
+      }
+    else if (key == "depth")
+      {
+      this->Depth = value.toInt(&valid);
+      valid = valid && this->Depth > 0 && this->Depth <= 64;
+      }
+    else
+      {
+      valid = false;
+      }
+    if (!valid)
+      {
+      error = QString("Invalid sweep setting '%1'.").arg(line.trimmed());
+      return false;
+      }
+    }
+
+  for (int i = 0, count = 0; i < timesteps.size(); ++i)
+    {
+    if (timesteps[i] >= start && timesteps[i] <= end && count++ % stride == 0)
+      {
+      this->Times.append(timesteps[i]);
+      }
+    }
+  if (this->Times.isEmpty())
+    {
+    error = QString("There are no timesteps between %1 and %2.").arg(start).arg(end);
+    return false;
+    }
+
+  pqServerManagerModel* model = pqApplicationCore::instance()->getServerManagerModel();
+  QList<pqView*> selected;
+  if (views == "active")
+    {
+    if (pqView* view = pqActiveObjects::instance().activeView())
+      {
+      selected.append(view);
+      }
+    }
+  else if (views == "all")
+    {
+    selected = model->findItems<pqView*>();
+    }
+  else
+    {
+    foreach (QString name, views.split(',', QString::SkipEmptyParts))
+      {
+      pqView* view = model->findItem<pqView*>(name.trimmed());
+      if (!view)
+        {
+        error = QString("There is no view named '%1'.").arg(name.trimmed());
+        return false;
+        }
+      selected.append(view);
+      }
+    }
+  if (selected.isEmpty())
+    {
+    error = "There is no view to sweep.";
+    return false;
+    }
+  foreach (pqView* view, selected)
+    {
+    this->Views.append(view);
+    this->ViewNames.append(view->getSMName());
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketSweep::description() const
+{
+  QStringList times;
+  foreach (double time, this->Times)
+    {
+    times.append(QString::number(time, 'g', 17));
+    }
+  QStringList views;
+  foreach (QString name, this->ViewNames)
+    {
+    views.append(pqSocketJSONString(name));
+    }
+  const char* codecs[] = {"png", "jpeg", "raw"};
+  return QString("{\"times\": [%1], \"views\": [%2], \"codec\": \"%3\", \"depth\": %4}")
+    .arg(times.join(", "), views.join(", ")).arg(codecs[this->Codec]).arg(this->Depth);
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::start()
+{
+  if (this->Started)
+    {
+    return;
+    }
+  this->Started = true;
+  this->OriginalTime = this->TimeKeeper->getTime();
+  this->StartTime = pqSocketHandler::currentTime();
+
+  // Images waiting for room in the output buffer are sent as the client
+  // reads.
+  if (this->Handler && this->Handler->socket())
+    {
+    this->connect(this->Handler->socket(), SIGNAL(bytesWritten(qint64)), SLOT(schedule()));
+    }
+  this->schedule();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::schedule()
+{
+  if (this->Started && !this->Finished && !this->Timer.isActive())
+    {
+    this->Timer.start();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::step()
+{
+  if (this->Finished)
+    {
+    return;
+    }
+  this->sendImages();
+
+  int views = this->Views.size();
+  if (this->SentImages == this->Times.size() * views)
+    {
+    this->finish();
+    return;
+    }
+
+  // One frame per turn of the event loop, so that other connections and a
+  // cancel are served in between.  Once depth frames are ahead, the next
+  // encoded image or the client reading resumes the sweep.
+  if (this->CapturedFrames < this->Times.size()
+      && this->CapturedFrames - this->SentImages / views < this->Depth)
+    {
+    this->captureFrame();
+    this->schedule();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::captureFrame()
+{
+  qint64 start = pqSocketHandler::currentTime();
+  this->TimeKeeper->setTime(this->Times[this->CapturedFrames]);
+  foreach (pqView* view, this->Views)
+    {
+    if (view)
+      {
+      view->getViewProxy()->Update();
+      }
+    }
+  qint64 updated = pqSocketHandler::currentTime();
+  foreach (pqView* view, this->Views)
+    {
+    if (view)
+      {
+      pqSocketRenderThrottle::instance()->forceRender(view);
+      }
+    }
+  qint64 rendered = pqSocketHandler::currentTime();
+
+  // A view closed during the sweep gets empty images.
+  int views = this->Views.size();
+  for (int i = 0; i < views; ++i)
+    {
+    vtkImageData* image = this->Views[i] ? this->Views[i]->captureImage(1) : NULL;
+    this->PendingJobs++;
+    this->Pool.start(new pqEncodeJob(this, this->CapturedFrames * views + i, image,
+                                     this->Codec, this->Quality));
+    }
+  qint64 readback = pqSocketHandler::currentTime();
+
+  this->StageTime[UpdateStage] += (updated - start) / 1000.0;
+  this->StageTime[RenderStage] += (rendered - updated) / 1000.0;
+  this->StageTime[ReadbackStage] += (readback - rendered) / 1000.0;
+  this->CapturedFrames++;
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::onImageEncoded(int image, const QByteArray& data, double milliseconds)
+{
+  // Images still encoding when the sweep was cancelled are dropped.
+  this->PendingJobs--;
+  if (this->Finished)
+    {
+    if (this->Released && !this->PendingJobs)
+      {
+      this->deleteLater();
+      }
+    return;
+    }
+  this->Encoded.insert(image, data);
+  this->EncodedImages++;
+  this->StageTime[EncodeStage] += milliseconds;
+  this->schedule();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::sendImages()
+{
+  // Like the chunks of a fetch, images are only written below the low water
+  // mark, the others wait in Encoded.
+  int views = this->Views.size();
+  while (this->Handler && this->Encoded.contains(this->SentImages)
+         && this->Handler->outputBuffered() < this->Handler->outputLowWaterMark())
+    {
+    QByteArray data = this->Encoded.take(this->SentImages);
+    qint64 start = pqSocketHandler::currentTime();
+    emit this->imageReady(this->SentImages % views, data);
+    this->StageTime[SendStage] += (pqSocketHandler::currentTime() - start) / 1000.0;
+    this->BytesSent += data.size();
+    this->SentImages++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::cancel()
+{
+  if (this->Finished)
+    {
+    return;
+    }
+  this->Cancelled = true;
+  this->Pool.clear();
+  this->Encoded.clear();
+  this->finish();
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::release()
+{
+  this->Released = true;
+  if (!this->PendingJobs)
+    {
+    this->deleteLater();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void pqSocketSweep::finish()
+{
+  this->Finished = true;
+  this->Timer.stop();
+  this->EndTime = pqSocketHandler::currentTime();
+  if (this->TimeKeeper && this->Started)
+    {
+    this->TimeKeeper->setTime(this->OriginalTime);
+    }
+  emit this->finished();
+}
+
+//-----------------------------------------------------------------------------
+QString pqSocketSweep::statistics() const
+{
+  // The encode time is summed over the threads of the pool, which share it.
+  int views = this->Views.size();
+  QStringList stages;
+  for (int i = 0; i < StageCount; ++i)
+    {
+    double frames = this->CapturedFrames;
+    if (i == EncodeStage)
+      {
+      frames = static_cast<double>(this->EncodedImages) * this->Pool.maxThreadCount() / views;
+      }
+    else if (i == SendStage)
+      {
+      frames = static_cast<double>(this->SentImages) / views;
+      }
+    double time = this->StageTime[i];
+    stages.append(QString("\"%1\": {\"milliseconds\": %2, \"frames_per_second\": %3}")
+      .arg(StageNames[i]).arg(jsonNumber(time))
+      .arg(jsonNumber(time > 0 ? 1000 * frames / time : 0)));
+    }
+
+  double total = (this->EndTime - this->StartTime) / 1000.0;
+  return QString("{\"frames\": %1, \"images\": %2, \"bytes\": %3, \"cancelled\": %4, "
+                 "\"milliseconds\": %5, \"frames_per_second\": %6, \"depth\": %7, "
+                 "\"encode_threads\": %8, \"stages\": {%9}}")
+    .arg(this->SentImages / views).arg(this->SentImages).arg(this->BytesSent)
+    .arg(this->Cancelled ? "true" : "false").arg(jsonNumber(total))
+    .arg(jsonNumber(total > 0 ? 1000 * (this->SentImages / views) / total : 0))
+    .arg(this->Depth).arg(this->Pool.maxThreadCount()).arg(stages.join(", "));
+}
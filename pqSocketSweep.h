@@ -0,0 +1,154 @@
+/*=========================================================================
+
+   Program: ParaView
+   Module:    pqSocketSweep.h
+
+   Copyright (c) 2005-2008 Sandia Corporation, Kitware Inc.
+   All rights reserved.
+
+   ParaView is a free software; you can redistribute it and/or modify it
+   under the terms of the ParaView license version 1.2. 
+
+   See License_v1.2.txt for the full ParaView license.
+   A copy of this license can be obtained by contacting
+   Kitware Inc.
+   28 Corporate Drive
+   Clifton Park, NY 12065
+   USA
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHORS OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+=========================================================================*/
+#ifndef _pqSocketSweep_h
+#define _pqSocketSweep_h
+
+#include "pqSocketImageEncoder.h"
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+class pqSocketHandler;
+class pqTimeKeeper;
+class pqView;
+
+// Steps the views through the timesteps answering a SweepMessage.  The
+// request payload holds key=value lines like a ConfigureMessage:
+//
+//   start, end  range of the times, the first and last timestep by default
+//   stride      every how many timesteps a frame is rendered, 1 by default
+//   views       'active', 'all' or a comma separated list of view names
+//   codec       'png', 'jpeg' or 'raw', see pqSocketImageEncoder
+//   quality     JPEG quality
+//   depth       frames rendered ahead of the ones sent, 4 by default
+//
+// The frames form a pipeline.  The GUI thread updates, renders and reads
+// back frame N+1 while the images of frame N are encoded by a pool of
+// threads and those of frame N-1 are written to the connection.  At most
+// depth frames are between readback and send, which bounds the memory held
+// and lets a slow client push back on the rendering.  Images are sent as
+// full frames in order, view by view.
+class pqSocketSweep : public QObject
+{
+  Q_OBJECT
+
+public:
+
+  pqSocketSweep(pqSocketHandler* handler, QObject* parent=0);
+  virtual ~pqSocketSweep();
+
+  // Parses the request and collects the times and views.  Returns false and
+  // sets error on failure.
+  bool initialize(const char* payload, int payloadSize, QString& error);
+
+  // JSON description of the times and views, in the order they are sent.
+  QString description() const;
+
+  void start();
+
+  // Drops the frames that were not sent yet and finishes.  Images that are
+  // being encoded are not waited for, their results are ignored.
+  void cancel();
+  bool isCancelled() const {return this->Cancelled;}
+
+  // Deletes the sweep once the encodes it started have returned.
+  void release();
+
+  // JSON with the number of frames and the time spent in every stage of the
+  // pipeline, in milliseconds, with the frames per second it alone allows.
+  QString statistics() const;
+
+signals:
+
+  // Emitted in order for every image, the receiver writes it.
+  void imageReady(int view, const QByteArray& image);
+
+  void finished();
+
+protected slots:
+
+  void step();
+  void schedule();
+  void onImageEncoded(int image, const QByteArray& data, double milliseconds);
+
+protected:
+
+  enum Stage
+    {
+    UpdateStage,
+    RenderStage,
+    ReadbackStage,
+    EncodeStage,
+    SendStage,
+    StageCount
+    };
+
+  void captureFrame();
+  void sendImages();
+  void finish();
+
+  QPointer<pqSocketHandler> Handler;
+  QPointer<pqTimeKeeper> TimeKeeper;
+  QList<double> Times;
+  QList<QPointer<pqView> > Views;
+  QStringList ViewNames;
+  pqSocketImageEncoder::Codec Codec;
+  int Quality;
+  int Depth;
+
+  double OriginalTime;
+  bool Started;
+  bool Finished;
+  bool Cancelled;
+  bool Released;
+  int PendingJobs;
+  int CapturedFrames;
+  int EncodedImages;
+  int SentImages;
+  QMap<int, QByteArray> Encoded;
+  QThreadPool Pool;
+  QTimer Timer;
+
+  qint64 StartTime;
+  qint64 EndTime;
+  double StageTime[StageCount];
+  qint64 BytesSent;
+};
+
+#endif